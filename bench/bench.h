@@ -0,0 +1,74 @@
+#ifndef KWM_BENCH_H
+#define KWM_BENCH_H
+
+#include "../kwm/kwm.h"
+#include "timing.h"
+
+// The benchmarks link the whole of Kwm without its main, and drive the
+// tree code on a screen that is never shown. Nothing here talks to the
+// accessibility API, so they run without any windows on screen.
+extern kwm_screen KWMScreen;
+extern std::map<unsigned int, screen_info> DisplayMap;
+extern space_tiling_option KwmSpaceMode;
+
+#define BENCH_SCREEN_ID 0
+#define BENCH_SPACE_ID 1
+
+screen_info *CreateBenchScreen()
+{
+    KWMScreen.SplitRatio = 0.5;
+    KWMScreen.SplitMode = -1;
+    KwmSpaceMode = SpaceModeBSP;
+
+    screen_info *Screen = &DisplayMap[BENCH_SCREEN_ID];
+    Screen->ID = BENCH_SCREEN_ID;
+    Screen->X = 0;
+    Screen->Y = 0;
+    Screen->Width = 2560;
+    Screen->Height = 1440;
+    Screen->ActiveSpace = BENCH_SPACE_ID;
+    Screen->Offset.PaddingTop = 40;
+    Screen->Offset.PaddingBottom = 20;
+    Screen->Offset.PaddingLeft = 20;
+    Screen->Offset.PaddingRight = 20;
+    Screen->Offset.VerticalGap = 10;
+    Screen->Offset.HorizontalGap = 10;
+    KWMScreen.Current = Screen;
+
+    space_info *Space = &Screen->Space[BENCH_SPACE_ID];
+    Space->Mode = SpaceModeBSP;
+    Space->Initialized = true;
+    Space->Offset = Screen->Offset;
+    return Screen;
+}
+
+std::vector<window_info> CreateBenchWindows(int Count)
+{
+    std::vector<window_info> Windows(Count);
+    for(int WindowIndex = 0; WindowIndex < Count; ++WindowIndex)
+    {
+        window_info *Window = &Windows[WindowIndex];
+        Window->Name = "bench";
+        Window->OwnerID = GetWindowOwnerID("bench");
+        Window->PID = 100 + WindowIndex % 16;
+        Window->WID = 1000 + WindowIndex;
+        Window->Layer = 0;
+        Window->X = 0;
+        Window->Y = 0;
+        Window->Width = 100;
+        Window->Height = 100;
+    }
+
+    return Windows;
+}
+
+std::vector<window_info*> GetBenchWindowPointers(std::vector<window_info> *Windows)
+{
+    std::vector<window_info*> Pointers;
+    for(std::size_t WindowIndex = 0; WindowIndex < Windows->size(); ++WindowIndex)
+        Pointers.push_back(&(*Windows)[WindowIndex]);
+
+    return Pointers;
+}
+
+#endif
@@ -0,0 +1,336 @@
+#include "../kwm/monitor.h"
+#include "timing.h"
+
+#include <algorithm>
+#include <stdlib.h>
+#include <unistd.h>
+
+// Measures the time from a window changing until the window monitor has
+// updated the tree, and how often it updated the tree to get there. A
+// scripted source stands in for the window server: it opens and closes
+// windows and drags them around at 60Hz, and pushes the events that the
+// observers would. The tree is stood in for by the list of windows that the
+// last update read. Whenever that list changed, the update retiles, which
+// writes a frame to every window, and every application echoes the write
+// with a moved notification, as they do for real.
+//
+// The script runs three times: through RunWindowMonitor, through
+// RunWindowMonitor with moves neither coalesced nor checked for echoes,
+// which is what every event used to cost, and with the old monitor that
+// read the window list every 200ms.
+#define BENCH_POLL_MILLISECONDS 200
+#define BENCH_STEPS 16
+#define BENCH_DRAG_MOVES 20
+#define BENCH_DRAG_MILLISECONDS 16
+
+kwm_monitor KWMMonitor;
+
+enum bench_monitor
+{
+    MonitorEvents,
+    MonitorEveryEvent,
+    MonitorPoll
+};
+
+enum fake_step_type
+{
+    StepAdd,
+    StepRemove,
+    StepDrag
+};
+
+struct fake_window
+{
+    int WID, PID, X;
+};
+
+struct fake_step
+{
+    fake_step_type Type;
+    int Delay;
+    kwm_time_point Pushed;
+    double Latency;
+};
+
+struct fake_window_source
+{
+    pthread_mutex_t Lock;
+    std::vector<fake_window> Windows;
+    std::vector<fake_step> Steps;
+    std::size_t StepsPushed;
+    int NextWID;
+    bool Done;
+    bool Echo;
+};
+
+fake_window_source FakeSource;
+std::vector<fake_window> SeenWindows;
+bool ScriptDone;
+
+fake_window CreateFakeWindow(int WID)
+{
+    fake_window Window = { WID, 100 + WID % 16, 0 };
+    return Window;
+}
+
+// The same script runs against every monitor. The list never drops below
+// two windows.
+void CreateFakeScript()
+{
+    srand(1);
+    FakeSource.Steps.clear();
+    int Count = 4;
+    for(int StepIndex = 0; StepIndex < BENCH_STEPS; ++StepIndex)
+    {
+        fake_step Step = {};
+        Step.Delay = 20 + rand() % 380;
+        Step.Latency = -1;
+        if(rand() % 3 == 0)
+            Step.Type = StepDrag;
+        else
+            Step.Type = Count <= 2 || (Count < 12 && rand() % 2) ? StepAdd : StepRemove;
+
+        if(Step.Type == StepAdd)
+            ++Count;
+        else if(Step.Type == StepRemove)
+            --Count;
+
+        FakeSource.Steps.push_back(Step);
+    }
+}
+
+// A drag is only done once the window has stopped, so its latency is
+// measured from the last of its moves.
+void * RunFakeWindowSource(void*)
+{
+    for(std::size_t StepIndex = 0; StepIndex < FakeSource.Steps.size(); ++StepIndex)
+    {
+        fake_step *Step = &FakeSource.Steps[StepIndex];
+        usleep(Step->Delay * 1000);
+
+        if(Step->Type == StepDrag)
+        {
+            pthread_mutex_lock(&FakeSource.Lock);
+            std::size_t WindowIndex = rand() % FakeSource.Windows.size();
+            pthread_mutex_unlock(&FakeSource.Lock);
+
+            for(int Move = 0; Move < BENCH_DRAG_MOVES; ++Move)
+            {
+                if(Move != 0)
+                    usleep(BENCH_DRAG_MILLISECONDS * 1000);
+
+                pthread_mutex_lock(&FakeSource.Lock);
+                fake_window *Window = &FakeSource.Windows[WindowIndex];
+                Window->X += 10;
+                int PID = Window->PID;
+                if(Move == BENCH_DRAG_MOVES - 1)
+                {
+                    Step->Pushed = std::chrono::steady_clock::now();
+                    FakeSource.StepsPushed = StepIndex + 1;
+                    FakeSource.Done = FakeSource.StepsPushed == FakeSource.Steps.size();
+                }
+
+                pthread_mutex_unlock(&FakeSource.Lock);
+                PushWindowEvent(WindowEventMoved, PID, -1);
+            }
+
+            continue;
+        }
+
+        pthread_mutex_lock(&FakeSource.Lock);
+        fake_window Window;
+        if(Step->Type == StepAdd)
+        {
+            Window = CreateFakeWindow(FakeSource.NextWID++);
+            FakeSource.Windows.push_back(Window);
+        }
+        else
+        {
+            std::size_t WindowIndex = rand() % FakeSource.Windows.size();
+            Window = FakeSource.Windows[WindowIndex];
+            FakeSource.Windows.erase(FakeSource.Windows.begin() + WindowIndex);
+        }
+
+        Step->Pushed = std::chrono::steady_clock::now();
+        FakeSource.StepsPushed = StepIndex + 1;
+        FakeSource.Done = FakeSource.StepsPushed == FakeSource.Steps.size();
+        pthread_mutex_unlock(&FakeSource.Lock);
+
+        PushWindowEvent(Step->Type == StepAdd ? WindowEventCreated : WindowEventDestroyed, Window.PID, Window.WID);
+    }
+
+    return NULL;
+}
+
+// Windows are only compared by frame if Frames is set, as the tree does not
+// change when a window is moved.
+bool AreFakeWindowsEqual(std::vector<fake_window> *A, std::vector<fake_window> *B, bool Frames)
+{
+    if(A->size() != B->size())
+        return false;
+
+    for(std::size_t WindowIndex = 0; WindowIndex < A->size(); ++WindowIndex)
+    {
+        if((*A)[WindowIndex].WID != (*B)[WindowIndex].WID ||
+           (Frames && (*A)[WindowIndex].X != (*B)[WindowIndex].X))
+            return false;
+    }
+
+    return true;
+}
+
+KWM_MONITOR_STEP(FakeRunCommands)
+{
+    return false;
+}
+
+KWM_MONITOR_HANDLE_EVENTS(FakeHandleEvents)
+{
+}
+
+KWM_MONITOR_STEP(FakeHasSpaceChanged)
+{
+    return false;
+}
+
+// Reads the fake list, and marks every step that was part of it as done.
+// Windows only have to be retiled when one was opened or closed.
+KWM_MONITOR_STEP(FakeUpdateWindows)
+{
+    pthread_mutex_lock(&FakeSource.Lock);
+    std::vector<fake_window> Windows = FakeSource.Windows;
+    std::size_t StepsSeen = FakeSource.StepsPushed;
+    bool Done = FakeSource.Done;
+    pthread_mutex_unlock(&FakeSource.Lock);
+
+    bool Retile = !AreFakeWindowsEqual(&Windows, &SeenWindows, false);
+    SeenWindows = Windows;
+
+    kwm_time_point Now = std::chrono::steady_clock::now();
+    for(std::size_t StepIndex = 0; StepIndex < StepsSeen; ++StepIndex)
+    {
+        fake_step *Step = &FakeSource.Steps[StepIndex];
+        if(Step->Latency < 0)
+            Step->Latency = std::chrono::duration<double, std::milli>(Now - Step->Pushed).count();
+    }
+
+    if(Retile && FakeSource.Echo)
+    {
+        for(std::size_t WindowIndex = 0; WindowIndex < Windows.size(); ++WindowIndex)
+        {
+            RecordFrameWrite(Windows[WindowIndex].PID);
+            PushWindowEvent(WindowEventMoved, Windows[WindowIndex].PID, -1);
+        }
+    }
+
+    ScriptDone = Done;
+    return false;
+}
+
+void ResetFakeMonitor(bench_monitor Monitor)
+{
+    KWMMonitor.RunCommands = FakeRunCommands;
+    KWMMonitor.HandleEvents = FakeHandleEvents;
+    KWMMonitor.UpdateWindows = FakeUpdateWindows;
+    KWMMonitor.HasSpaceChanged = FakeHasSpaceChanged;
+    KWMMonitor.PollTimeout = 1000;
+    KWMMonitor.TransitionTimeout = 200;
+    KWMMonitor.SpaceTimeout = 200;
+    KWMMonitor.MoveDelay = Monitor == MonitorEvents ? 200 : 0;
+    KWMMonitor.EchoTimeout = Monitor == MonitorEvents ? 250 : -1;
+
+    KWMMonitor.Queue.clear();
+    KWMMonitor.FrameWrites.clear();
+    KWMMonitor.Woken = false;
+    KWMMonitor.Transition = false;
+    KWMMonitor.MovePending = false;
+    KWMMonitor.LastUpdate = KWMMonitor.LastProbe = std::chrono::steady_clock::now();
+    KWMMonitor.Updates = 0;
+    KWMMonitor.CoalescedMoves = 0;
+    KWMMonitor.EchoedMoves = 0;
+}
+
+// Runs the script against one kind of monitor and returns the number of
+// times the tree was updated, or -1 if the last update did not see the
+// final window list.
+int RunMonitor(bench_monitor Monitor)
+{
+    ResetFakeMonitor(Monitor);
+    FakeSource.Windows.clear();
+    for(int WID = 1000; WID < 1004; ++WID)
+        FakeSource.Windows.push_back(CreateFakeWindow(WID));
+
+    FakeSource.NextWID = 1004;
+    FakeSource.StepsPushed = 0;
+    FakeSource.Done = false;
+    FakeSource.Echo = Monitor != MonitorPoll;
+    SeenWindows = FakeSource.Windows;
+    ScriptDone = false;
+    CreateFakeScript();
+
+    pthread_t SourceThread;
+    pthread_create(&SourceThread, NULL, &RunFakeWindowSource, NULL);
+
+    int Updates = 0;
+    std::vector<window_event> Events;
+    int Timeout = KWMMonitor.PollTimeout;
+    while(!ScriptDone)
+    {
+        if(Monitor == MonitorPoll)
+        {
+            usleep(BENCH_POLL_MILLISECONDS * 1000);
+            FakeUpdateWindows();
+            ++Updates;
+        }
+        else
+        {
+            WaitForWindowEvents(&Events, Timeout);
+            Timeout = RunWindowMonitor(&Events, std::chrono::steady_clock::now());
+            Updates = KWMMonitor.Updates;
+        }
+    }
+
+    pthread_join(SourceThread, NULL);
+    if(!AreFakeWindowsEqual(&SeenWindows, &FakeSource.Windows, true))
+        Updates = -1;
+
+    return Updates;
+}
+
+void PrintLatency(const char *Name, int Updates)
+{
+    std::vector<double> Latencies;
+    for(std::size_t StepIndex = 0; StepIndex < FakeSource.Steps.size(); ++StepIndex)
+        Latencies.push_back(FakeSource.Steps[StepIndex].Latency);
+
+    std::sort(Latencies.begin(), Latencies.end());
+    std::cout << "event_bench: " << std::left << std::setw(12) << Name
+              << " p50 " << std::setw(10) << FormatBenchTime(Latencies[Latencies.size() / 2])
+              << "max " << std::setw(10) << FormatBenchTime(Latencies.back())
+              << "tree updates " << std::setw(5) << Updates
+              << "coalesced " << std::setw(5) << KWMMonitor.CoalescedMoves
+              << "echoes " << KWMMonitor.EchoedMoves << std::right << std::endl;
+}
+
+int main()
+{
+    if(!KwmStartWindowMonitor() ||
+       pthread_mutex_init(&FakeSource.Lock, NULL) != 0)
+        return 1;
+
+    const char *Names[] = { "events", "every event", "poll" };
+    bench_monitor Monitors[] = { MonitorEvents, MonitorEveryEvent, MonitorPoll };
+
+    bool Result = true;
+    for(int MonitorIndex = 0; MonitorIndex < 3; ++MonitorIndex)
+    {
+        int Updates = RunMonitor(Monitors[MonitorIndex]);
+        Result = Result && Updates != -1;
+        PrintLatency(Names[MonitorIndex], Updates);
+    }
+
+    if(!Result)
+        std::cout << "event_bench: the last update did not see the final window list" << std::endl;
+
+    return Result ? 0 : 1;
+}
@@ -0,0 +1,128 @@
+#include "bench.h"
+
+// Compares hit-testing the cursor with GetWindowAtPoint against scanning
+// WindowLst, which FocusWindowBelowCursor did on every mouse-move before
+// the grid. The cost of rebuilding the grid is reported separately, as it
+// is paid once after every change of the window list.
+extern std::vector<window_info> WindowLst;
+
+window_info *GetWindowAtPointByScan(CGPoint Point)
+{
+    for(std::size_t WindowIndex = 0; WindowIndex < WindowLst.size(); ++WindowIndex)
+    {
+        window_info *Window = &WindowLst[WindowIndex];
+        if(Point.x >= Window->X &&
+           Point.x <= Window->X + Window->Width &&
+           Point.y >= Window->Y &&
+           Point.y <= Window->Y + Window->Height)
+        {
+            return Window;
+        }
+    }
+
+    return NULL;
+}
+
+// The windows are tiled over two displays side by side, the way Kwm lays
+// them out, so a point hits at most one window and a scan has to look at
+// half of the list on average. Every fourth window floats on top of the
+// tiles at a random position.
+void CreateBenchWindowList(int Count)
+{
+    WindowLst = CreateBenchWindows(Count);
+    int Columns = 1;
+    while(Columns * Columns < Count)
+        ++Columns;
+
+    int Rows = (Count + Columns - 1) / Columns;
+    int Width = 5120 / Columns;
+    int Height = 1440 / Rows;
+    for(int WindowIndex = 0; WindowIndex < Count; ++WindowIndex)
+    {
+        window_info *Window = &WindowLst[WindowIndex];
+        if(WindowIndex % 4 == 3)
+        {
+            Window->X = rand() % 4800;
+            Window->Y = rand() % 1200;
+            Window->Width = 320;
+            Window->Height = 240;
+        }
+        else
+        {
+            Window->X = (WindowIndex % Columns) * Width + 5;
+            Window->Y = (WindowIndex / Columns) * Height + 5;
+            Window->Width = Width - 10;
+            Window->Height = Height - 10;
+        }
+    }
+
+    InvalidateWindowGrid();
+}
+
+// Every result is stored, so that the compiler cannot drop the hit tests.
+window_info * volatile HitWindow;
+
+#define BENCH_POINTS 1024
+int main()
+{
+    srand(1);
+    std::vector<CGPoint> Points(BENCH_POINTS);
+    for(int PointIndex = 0; PointIndex < BENCH_POINTS; ++PointIndex)
+    {
+        Points[PointIndex].x = rand() % 5120;
+        Points[PointIndex].y = rand() % 1440;
+    }
+
+    bool Result = true;
+    int WindowCounts[] = { 10, 50, 200, 1000 };
+    for(int CountIndex = 0; CountIndex < 4; ++CountIndex)
+    {
+        int Count = WindowCounts[CountIndex];
+        CreateBenchWindowList(Count);
+        for(int PointIndex = 0; PointIndex < BENCH_POINTS; ++PointIndex)
+        {
+            if(GetWindowAtPoint(Points[PointIndex]) != GetWindowAtPointByScan(Points[PointIndex]))
+                Result = false;
+        }
+
+        int Runs = 0;
+        kwm_time_point Start = std::chrono::steady_clock::now();
+        while(ShouldBenchContinue(Runs, Start))
+        {
+            for(int PointIndex = 0; PointIndex < BENCH_POINTS; ++PointIndex)
+                HitWindow = GetWindowAtPointByScan(Points[PointIndex]);
+
+            ++Runs;
+        }
+        double Scan = GetBenchMilliseconds(Start) / Runs / BENCH_POINTS;
+
+        Runs = 0;
+        Start = std::chrono::steady_clock::now();
+        while(ShouldBenchContinue(Runs, Start))
+        {
+            for(int PointIndex = 0; PointIndex < BENCH_POINTS; ++PointIndex)
+                HitWindow = GetWindowAtPoint(Points[PointIndex]);
+
+            ++Runs;
+        }
+        double Grid = GetBenchMilliseconds(Start) / Runs / BENCH_POINTS;
+
+        Runs = 0;
+        Start = std::chrono::steady_clock::now();
+        while(ShouldBenchContinue(Runs, Start))
+        {
+            BuildWindowGrid();
+            ++Runs;
+        }
+        double Build = GetBenchMilliseconds(Start) / Runs;
+
+        std::cout << "grid_bench: " << std::setw(4) << Count << " windows, hit test scan " << std::left << std::setw(10) << FormatBenchTime(Scan)
+                  << "grid " << std::setw(10) << FormatBenchTime(Grid)
+                  << "grid rebuild " << FormatBenchTime(Build) << std::right << std::endl;
+    }
+
+    if(!Result)
+        std::cout << "grid_bench: the grid and the scan disagree" << std::endl;
+
+    return Result ? 0 : 1;
+}
@@ -0,0 +1,328 @@
+#include "../kwm/ingest.h"
+#include "timing.h"
+
+#include <deque>
+#include <fstream>
+#include <set>
+
+// Compares reading a window list with GetWindowInfo against the old
+// CFDictionaryApplyFunction callback, which built a std::string for every
+// key of every window and compared it against a chain of literals. The
+// window lists are replayed from snapshots in the format that
+// record_window_list writes, through a stand-in for the CF dictionaries.
+// Keys are interned, so that they compare by pointer the way the CFString
+// constants of CoreGraphics do.
+struct snapshot_entry;
+
+struct snapshot_field
+{
+    const char *Key;
+    char Type;
+    long long Int;
+    double Float;
+    std::string String;
+    const snapshot_entry *Dictionary;
+};
+
+struct snapshot_entry
+{
+    std::vector<snapshot_field> Fields;
+};
+
+struct window_snapshot
+{
+    std::string Name;
+    std::vector<snapshot_entry> Windows;
+    std::deque<snapshot_entry> Dictionaries;
+};
+
+struct keyed_window
+{
+    window_info Window;
+    std::string Owner;
+};
+
+std::set<std::string> SnapshotKeyNames;
+const char *SnapshotKeys[5];
+const char *BoundsKeys[5];
+
+const char *InternSnapshotKey(const std::string &Name)
+{
+    return SnapshotKeyNames.insert(Name).first->c_str();
+}
+
+const snapshot_field *FindSnapshotField(const void *Entry, const char *Key)
+{
+    const std::vector<snapshot_field> &Fields = ((const snapshot_entry*)Entry)->Fields;
+    for(std::size_t FieldIndex = 0; FieldIndex < Fields.size(); ++FieldIndex)
+    {
+        if(Fields[FieldIndex].Key == Key)
+            return &Fields[FieldIndex];
+    }
+
+    return NULL;
+}
+
+bool GetSnapshotNumber(const snapshot_field *Field, int *Value)
+{
+    if(!Field || (Field->Type != 'i' && Field->Type != 'f'))
+        return false;
+
+    *Value = Field->Type == 'i' ? Field->Int : Field->Float;
+    return true;
+}
+
+KWM_WINDOW_GET_NUMBER(SnapshotGetWindowNumber)
+{
+    return GetSnapshotNumber(FindSnapshotField(Entry, SnapshotKeys[Key]), Value);
+}
+
+KWM_WINDOW_GET_STRING(SnapshotGetWindowString)
+{
+    const snapshot_field *Field = FindSnapshotField(Entry, SnapshotKeys[Key]);
+    return Field && Field->Type == 's' ? Field->String.c_str() : NULL;
+}
+
+KWM_WINDOW_GET_BOUNDS(SnapshotGetWindowBounds)
+{
+    *X = *Y = *Width = *Height = 0;
+    const snapshot_field *Bounds = FindSnapshotField(Entry, BoundsKeys[0]);
+    if(!Bounds || Bounds->Type != 'd')
+        return false;
+
+    return GetSnapshotNumber(FindSnapshotField(Bounds->Dictionary, BoundsKeys[1]), X) &&
+           GetSnapshotNumber(FindSnapshotField(Bounds->Dictionary, BoundsKeys[2]), Y) &&
+           GetSnapshotNumber(FindSnapshotField(Bounds->Dictionary, BoundsKeys[3]), Width) &&
+           GetSnapshotNumber(FindSnapshotField(Bounds->Dictionary, BoundsKeys[4]), Height);
+}
+
+kwm_window_reader KWMReader = { SnapshotGetWindowNumber, SnapshotGetWindowString, SnapshotGetWindowBounds };
+
+std::string UnescapeSnapshotString(const std::string &String)
+{
+    std::string Result;
+    for(std::size_t CharIndex = 0; CharIndex < String.size(); ++CharIndex)
+    {
+        if(String[CharIndex] == '\\' && CharIndex + 1 < String.size())
+        {
+            char Escaped = String[++CharIndex];
+            Result += Escaped == 't' ? '\t' : Escaped == 'n' ? '\n' : Escaped;
+        }
+        else
+        {
+            Result += String[CharIndex];
+        }
+    }
+
+    return Result;
+}
+
+// A window is split into its fields at tabs, and a dictionary at the
+// semicolons that only dictionaries contain.
+void ParseSnapshotEntry(window_snapshot *Snapshot, const std::string &Text, char Separator, snapshot_entry *Entry)
+{
+    std::size_t Start = 0;
+    while(Start < Text.size())
+    {
+        std::size_t End = Text.find(Separator, Start);
+        if(End == std::string::npos)
+            End = Text.size();
+
+        std::size_t Equals = Text.find('=', Start);
+        if(Equals == std::string::npos || Equals + 2 >= End || Text[Equals + 2] != ':')
+            break;
+
+        snapshot_field Field = {};
+        Field.Key = InternSnapshotKey(Text.substr(Start, Equals - Start));
+        Field.Type = Text[Equals + 1];
+
+        std::string Value = Text.substr(Equals + 3, End - Equals - 3);
+        if(Field.Type == 'i' || Field.Type == 'b')
+        {
+            Field.Int = atoll(Value.c_str());
+        }
+        else if(Field.Type == 'f')
+        {
+            Field.Float = atof(Value.c_str());
+        }
+        else if(Field.Type == 's')
+        {
+            Field.String = UnescapeSnapshotString(Value);
+        }
+        else if(Field.Type == 'd')
+        {
+            Snapshot->Dictionaries.push_back(snapshot_entry());
+            ParseSnapshotEntry(Snapshot, Value, ';', &Snapshot->Dictionaries.back());
+            Field.Dictionary = &Snapshot->Dictionaries.back();
+        }
+
+        Entry->Fields.push_back(Field);
+        Start = End + 1;
+    }
+}
+
+bool LoadWindowSnapshot(const char *Path, window_snapshot *Snapshot)
+{
+    std::ifstream File(Path);
+    if(!File)
+        return false;
+
+    Snapshot->Name = Path;
+    std::string Line;
+    while(std::getline(File, Line))
+    {
+        if(Line.empty() || Line[0] == '#')
+            continue;
+
+        Snapshot->Windows.push_back(snapshot_entry());
+        ParseSnapshotEntry(Snapshot, Line, '\t', &Snapshot->Windows.back());
+    }
+
+    return true;
+}
+
+// As the old callback did, except that numbers are read into a 64-bit
+// integer here. The old callback read kCFNumberSInt64Type into an int,
+// which overran it.
+void GetWindowInfoByKeyName(const snapshot_entry *Entry, keyed_window *Keyed)
+{
+    for(std::size_t FieldIndex = 0; FieldIndex < Entry->Fields.size(); ++FieldIndex)
+    {
+        const snapshot_field *Field = &Entry->Fields[FieldIndex];
+        std::string KeyStr = Field->Key;
+        if(Field->Type == 's')
+        {
+            std::string ValueStr = Field->String;
+            if(KeyStr == "kCGWindowName")
+                Keyed->Window.Name = ValueStr;
+            else if(KeyStr == "kCGWindowOwnerName")
+                Keyed->Owner = ValueStr;
+        }
+        else if(Field->Type == 'i' || Field->Type == 'f')
+        {
+            long long MyInt = Field->Type == 'i' ? Field->Int : (long long)Field->Float;
+            if(KeyStr == "kCGWindowNumber")
+                Keyed->Window.WID = MyInt;
+            else if(KeyStr == "kCGWindowOwnerPID")
+                Keyed->Window.PID = MyInt;
+            else if(KeyStr == "kCGWindowLayer")
+                Keyed->Window.Layer = MyInt;
+            else if(KeyStr == "X")
+                Keyed->Window.X = MyInt;
+            else if(KeyStr == "Y")
+                Keyed->Window.Y = MyInt;
+            else if(KeyStr == "Width")
+                Keyed->Window.Width = MyInt;
+            else if(KeyStr == "Height")
+                Keyed->Window.Height = MyInt;
+        }
+        else if(Field->Type == 'd')
+        {
+            GetWindowInfoByKeyName(Field->Dictionary, Keyed);
+        }
+    }
+}
+
+// As UpdateActiveWindowList did before: the list is cleared, and every
+// window is appended and filled in by the callback.
+void IngestByKeyName(window_snapshot *Snapshot, std::vector<keyed_window> *Windows)
+{
+    Windows->clear();
+    for(std::size_t WindowIndex = 0; WindowIndex < Snapshot->Windows.size(); ++WindowIndex)
+    {
+        Windows->push_back(keyed_window());
+        GetWindowInfoByKeyName(&Snapshot->Windows[WindowIndex], &Windows->back());
+    }
+}
+
+// As UpdateActiveWindowList does now: the back buffer is overwritten in
+// place and swapped with the front.
+void IngestDirect(window_snapshot *Snapshot, std::vector<window_info> *Front, std::vector<window_info> *Back)
+{
+    Back->resize(Snapshot->Windows.size());
+    for(std::size_t WindowIndex = 0; WindowIndex < Snapshot->Windows.size(); ++WindowIndex)
+        GetWindowInfo(&Snapshot->Windows[WindowIndex], &(*Back)[WindowIndex]);
+
+    Front->swap(*Back);
+}
+
+bool IsIngestionEqual(std::vector<keyed_window> *Keyed, std::vector<window_info> *Direct)
+{
+    if(Keyed->size() != Direct->size())
+        return false;
+
+    for(std::size_t WindowIndex = 0; WindowIndex < Keyed->size(); ++WindowIndex)
+    {
+        window_info *A = &(*Keyed)[WindowIndex].Window;
+        window_info *B = &(*Direct)[WindowIndex];
+        if(A->WID != B->WID || A->PID != B->PID || A->Layer != B->Layer ||
+           A->X != B->X || A->Y != B->Y || A->Width != B->Width || A->Height != B->Height ||
+           A->Name != B->Name || (*Keyed)[WindowIndex].Owner != GetWindowOwner(B))
+            return false;
+    }
+
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    const char *Keys[] = { "kCGWindowNumber", "kCGWindowOwnerPID", "kCGWindowLayer", "kCGWindowName", "kCGWindowOwnerName" };
+    for(int KeyIndex = 0; KeyIndex < 5; ++KeyIndex)
+        SnapshotKeys[KeyIndex] = InternSnapshotKey(Keys[KeyIndex]);
+
+    const char *Bounds[] = { "kCGWindowBounds", "X", "Y", "Width", "Height" };
+    for(int KeyIndex = 0; KeyIndex < 5; ++KeyIndex)
+        BoundsKeys[KeyIndex] = InternSnapshotKey(Bounds[KeyIndex]);
+
+    std::vector<const char *> Paths(argv + 1, argv + argc);
+    if(Paths.empty())
+    {
+        Paths.push_back("bench/snapshots/desktop.txt");
+        Paths.push_back("bench/snapshots/busy.txt");
+    }
+
+    bool Result = true;
+    for(std::size_t PathIndex = 0; PathIndex < Paths.size(); ++PathIndex)
+    {
+        window_snapshot Snapshot;
+        if(!LoadWindowSnapshot(Paths[PathIndex], &Snapshot))
+        {
+            std::cout << "ingest_bench: could not read " << Paths[PathIndex] << std::endl;
+            Result = false;
+            continue;
+        }
+
+        std::vector<keyed_window> Keyed;
+        std::vector<window_info> Front, Back;
+        IngestByKeyName(&Snapshot, &Keyed);
+        IngestDirect(&Snapshot, &Front, &Back);
+        if(!IsIngestionEqual(&Keyed, &Front))
+        {
+            std::cout << "ingest_bench: " << Snapshot.Name << ", the two readers disagree" << std::endl;
+            Result = false;
+        }
+
+        int Runs = 0;
+        std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+        while(ShouldBenchContinue(Runs, Start))
+        {
+            IngestByKeyName(&Snapshot, &Keyed);
+            ++Runs;
+        }
+        double ByKeyName = GetBenchMilliseconds(Start) / Runs;
+
+        Runs = 0;
+        Start = std::chrono::steady_clock::now();
+        while(ShouldBenchContinue(Runs, Start))
+        {
+            IngestDirect(&Snapshot, &Front, &Back);
+            ++Runs;
+        }
+        double Direct = GetBenchMilliseconds(Start) / Runs;
+
+        std::cout << "ingest_bench: " << std::setw(4) << Snapshot.Windows.size() << " windows from " << Snapshot.Name << ", key names " << std::left << std::setw(10) << FormatBenchTime(ByKeyName)
+                  << "direct " << FormatBenchTime(Direct) << std::right << std::endl;
+    }
+
+    return Result ? 0 : 1;
+}
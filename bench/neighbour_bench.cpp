@@ -0,0 +1,221 @@
+#include "bench.h"
+
+// Compares stepping to a neighbouring leaf through the PrevLeaf and NextLeaf
+// links against climbing the tree, which is how GetNearestNodeToTheLeft and
+// GetNearestNodeToTheRight found the neighbour before the leaves were linked.
+tree_node *ClimbToNodeOnTheLeft(tree_node *Node)
+{
+    if(Node && Node->Parent)
+    {
+        tree_node *Root = Node->Parent;
+        if(Root->LeftChild == Node)
+            return ClimbToNodeOnTheLeft(Root);
+
+        if(IsLeafNode(Root->LeftChild))
+            return Root->LeftChild;
+
+        Root = Root->LeftChild;
+        while(!IsLeafNode(Root->RightChild))
+            Root = Root->RightChild;
+
+        return Root->RightChild;
+    }
+
+    return NULL;
+}
+
+tree_node *ClimbToNodeOnTheRight(tree_node *Node)
+{
+    if(Node && Node->Parent)
+    {
+        tree_node *Root = Node->Parent;
+        if(Root->RightChild == Node)
+            return ClimbToNodeOnTheRight(Root);
+
+        if(IsLeafNode(Root->RightChild))
+            return Root->RightChild;
+
+        Root = Root->RightChild;
+        while(!IsLeafNode(Root->LeftChild))
+            Root = Root->LeftChild;
+
+        return Root->LeftChild;
+    }
+
+    return NULL;
+}
+
+// The first window is split off the root, and every following window off
+// the last leaf of the left half. The left half becomes a chain as deep as
+// there are windows, and the neighbours across the root split are the
+// worst case for climbing: each step climbs or descends the whole chain.
+tree_node *CreateDeepTree(screen_info *Screen, std::vector<window_info*> *Windows)
+{
+    space_info *Space = &Screen->Space[Screen->ActiveSpace];
+    tree_node *RootNode = CreateRootNode(Screen);
+    SetRootNodeContainer(Screen, RootNode);
+    SetNodeWindowID(Space, RootNode, (*Windows)[0]->WID);
+    CreateLeafNodePair(Screen, RootNode, (*Windows)[0]->WID, (*Windows)[1]->WID, 1);
+
+    tree_node *Leaf = RootNode->LeftChild;
+    for(std::size_t WindowIndex = 2; WindowIndex < Windows->size(); ++WindowIndex)
+    {
+        CreateLeafNodePair(Screen, Leaf, Leaf->WindowID, (*Windows)[WindowIndex]->WID, WindowIndex % 2 ? 1 : 2);
+        Leaf = Leaf->RightChild;
+    }
+
+    return RootNode;
+}
+
+// Walks every leaf from left to right and back, one neighbour at a time, as
+// a chain of focus-next and focus-prev commands would.
+int WalkLeavesByLinks(tree_node *RootNode)
+{
+    int Steps = 0;
+    tree_node *Node = GetFirstLeafNode(RootNode);
+    while((Node = GetNearestNodeToTheRight(Node, SpaceModeBSP)))
+        ++Steps;
+
+    Node = GetLastLeafNode(RootNode);
+    while((Node = GetNearestNodeToTheLeft(Node, SpaceModeBSP)))
+        ++Steps;
+
+    return Steps;
+}
+
+int WalkLeavesByClimbing(tree_node *RootNode)
+{
+    int Steps = 0;
+    tree_node *Node = GetFirstLeafNode(RootNode);
+    while((Node = ClimbToNodeOnTheRight(Node)))
+        ++Steps;
+
+    Node = GetLastLeafNode(RootNode);
+    while((Node = ClimbToNodeOnTheLeft(Node)))
+        ++Steps;
+
+    return Steps;
+}
+
+// Steps back and forth between the two leaves on either side of the root
+// split, as repeated focus-next and focus-prev commands between them would.
+#define BENCH_HOPS 1000
+int HopAcrossRootByLinks(tree_node *RootNode)
+{
+    int Steps = 0;
+    tree_node *Node = GetLastLeafNode(RootNode->LeftChild);
+    for(int HopIndex = 0; HopIndex < BENCH_HOPS; ++HopIndex)
+    {
+        Node = GetNearestNodeToTheRight(Node, SpaceModeBSP);
+        Node = GetNearestNodeToTheLeft(Node, SpaceModeBSP);
+        Steps += 2;
+    }
+
+    return Node ? Steps : 0;
+}
+
+int HopAcrossRootByClimbing(tree_node *RootNode)
+{
+    int Steps = 0;
+    tree_node *Node = GetLastLeafNode(RootNode->LeftChild);
+    for(int HopIndex = 0; HopIndex < BENCH_HOPS; ++HopIndex)
+    {
+        Node = ClimbToNodeOnTheRight(Node);
+        Node = ClimbToNodeOnTheLeft(Node);
+        Steps += 2;
+    }
+
+    return Node ? Steps : 0;
+}
+
+bool DoWalksAgree(tree_node *RootNode)
+{
+    tree_node *Linked = GetFirstLeafNode(RootNode);
+    tree_node *Climbed = Linked;
+    while(Linked || Climbed)
+    {
+        if(Linked != Climbed)
+            return false;
+
+        Linked = GetNearestNodeToTheRight(Linked, SpaceModeBSP);
+        Climbed = ClimbToNodeOnTheRight(Climbed);
+    }
+
+    Linked = GetLastLeafNode(RootNode);
+    Climbed = Linked;
+    while(Linked || Climbed)
+    {
+        if(Linked != Climbed)
+            return false;
+
+        Linked = GetNearestNodeToTheLeft(Linked, SpaceModeBSP);
+        Climbed = ClimbToNodeOnTheLeft(Climbed);
+    }
+
+    return true;
+}
+
+typedef int bench_walk(tree_node *);
+
+double BenchWalk(tree_node *RootNode, bench_walk *Walk, int *Steps)
+{
+    int Runs = 0;
+    kwm_time_point Start = std::chrono::steady_clock::now();
+    while(ShouldBenchContinue(Runs, Start))
+    {
+        *Steps = Walk(RootNode);
+        ++Runs;
+    }
+
+    return GetBenchMilliseconds(Start) / Runs;
+}
+
+void PrintWalkResult(const char *Shape, int Leaves, const char *Name, bench_walk *Climb, bench_walk *Link, tree_node *RootNode)
+{
+    int Steps = 0;
+    double Climbing = BenchWalk(RootNode, Climb, &Steps);
+    double Links = BenchWalk(RootNode, Link, &Steps);
+    std::cout << "neighbour_bench: " << std::left << std::setw(9) << Shape << std::right << std::setw(6) << Leaves << " leaves, "
+              << std::left << std::setw(5) << Name << std::right
+              << std::fixed << std::setprecision(1)
+              << " climbing " << std::setw(8) << Climbing * 1000000 / Steps << "ns/step"
+              << ", links " << std::setw(6) << Links * 1000000 / Steps << "ns/step" << std::endl;
+}
+
+bool BenchTree(const char *Shape, int Leaves, tree_node *RootNode)
+{
+    if(!DoWalksAgree(RootNode))
+    {
+        std::cout << "neighbour_bench: " << Shape << " tree of " << Leaves << " leaves, walks disagree" << std::endl;
+        return false;
+    }
+
+    PrintWalkResult(Shape, Leaves, "walk", WalkLeavesByClimbing, WalkLeavesByLinks, RootNode);
+    PrintWalkResult(Shape, Leaves, "hop", HopAcrossRootByClimbing, HopAcrossRootByLinks, RootNode);
+    return true;
+}
+
+int main()
+{
+    screen_info *Screen = CreateBenchScreen();
+    space_info *Space = &Screen->Space[Screen->ActiveSpace];
+    bool Result = true;
+
+    int LeafCounts[] = { 10, 100, 1000, 10000 };
+    for(int CountIndex = 0; CountIndex < 4; ++CountIndex)
+    {
+        int Leaves = LeafCounts[CountIndex];
+        std::vector<window_info> Windows = CreateBenchWindows(Leaves);
+        std::vector<window_info*> WindowPointers = GetBenchWindowPointers(&Windows);
+
+        Space->RootNode = CreateTreeFromWindowIDList(Screen, &WindowPointers);
+        Result = BenchTree("balanced", Leaves, Space->RootNode) && Result;
+        DestroyNodeTree(Space);
+
+        Space->RootNode = CreateDeepTree(Screen, &WindowPointers);
+        Result = BenchTree("deep", Leaves, Space->RootNode) && Result;
+        DestroyNodeTree(Space);
+    }
+
+    return Result ? 0 : 1;
+}
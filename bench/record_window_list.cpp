@@ -0,0 +1,115 @@
+#include <Carbon/Carbon.h>
+
+#include <iostream>
+#include <string>
+#include <string.h>
+
+// Writes the window list that Kwm reads to stdout, in the snapshot format
+// that ingest_bench replays:
+//
+//   make bin/bench/record_window_list
+//   bin/bench/record_window_list > bench/snapshots/<name>.txt
+//
+// Every window is one line of tab-separated Key=Type:Value fields. The type
+// is i for integers, f for floating point numbers, b for booleans and s for
+// strings, in which backslashes, tabs and newlines are escaped. The type d
+// is a dictionary, whose fields are separated by semicolons instead.
+std::string EscapeSnapshotString(const std::string &String)
+{
+    std::string Result;
+    for(std::size_t CharIndex = 0; CharIndex < String.size(); ++CharIndex)
+    {
+        char Char = String[CharIndex];
+        if(Char == '\\')
+            Result += "\\\\";
+        else if(Char == '\t')
+            Result += "\\t";
+        else if(Char == '\n')
+            Result += "\\n";
+        else
+            Result += Char;
+    }
+
+    return Result;
+}
+
+std::string GetSnapshotString(CFStringRef String)
+{
+    CFIndex Size = CFStringGetMaximumSizeForEncoding(CFStringGetLength(String), kCFStringEncodingUTF8) + 1;
+    std::string Result(Size, '\0');
+    if(!CFStringGetCString(String, &Result[0], Size, kCFStringEncodingUTF8))
+        return "";
+
+    Result.resize(strlen(Result.c_str()));
+    return Result;
+}
+
+struct snapshot_line
+{
+    std::string Text;
+    const char *Separator;
+};
+
+void WriteSnapshotField(const void *Key, const void *Value, void *Context)
+{
+    snapshot_line *Line = (snapshot_line*)Context;
+    std::string Field = GetSnapshotString((CFStringRef)Key) + "=";
+
+    CFTypeID ID = CFGetTypeID(Value);
+    if(ID == CFNumberGetTypeID())
+    {
+        CFNumberRef Number = (CFNumberRef)Value;
+        if(CFNumberIsFloatType(Number))
+        {
+            double Float = 0;
+            CFNumberGetValue(Number, kCFNumberDoubleType, &Float);
+            Field += "f:" + std::to_string(Float);
+        }
+        else
+        {
+            long long Int = 0;
+            CFNumberGetValue(Number, kCFNumberLongLongType, &Int);
+            Field += "i:" + std::to_string(Int);
+        }
+    }
+    else if(ID == CFBooleanGetTypeID())
+    {
+        Field += std::string("b:") + (CFBooleanGetValue((CFBooleanRef)Value) ? "1" : "0");
+    }
+    else if(ID == CFStringGetTypeID())
+    {
+        Field += "s:" + EscapeSnapshotString(GetSnapshotString((CFStringRef)Value));
+    }
+    else if(ID == CFDictionaryGetTypeID())
+    {
+        snapshot_line Dictionary = { "", ";" };
+        CFDictionaryApplyFunction((CFDictionaryRef)Value, WriteSnapshotField, &Dictionary);
+        Field += "d:" + Dictionary.Text;
+    }
+    else
+    {
+        return;
+    }
+
+    if(!Line->Text.empty())
+        Line->Text += Line->Separator;
+
+    Line->Text += Field;
+}
+
+int main()
+{
+    CFArrayRef WindowList = CGWindowListCopyWindowInfo(kCGWindowListOptionOnScreenOnly | kCGWindowListExcludeDesktopElements, kCGNullWindowID);
+    if(!WindowList)
+        return 1;
+
+    for(CFIndex WindowIndex = 0; WindowIndex < CFArrayGetCount(WindowList); ++WindowIndex)
+    {
+        snapshot_line Line = { "", "\t" };
+        CFDictionaryApplyFunction((CFDictionaryRef)CFArrayGetValueAtIndex(WindowList, WindowIndex), WriteSnapshotField, &Line);
+        std::cout << Line.Text << std::endl;
+    }
+
+    CFRelease(WindowList);
+    return 0;
+}
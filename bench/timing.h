@@ -0,0 +1,40 @@
+#ifndef KWM_BENCH_TIMING_H
+#define KWM_BENCH_TIMING_H
+
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+
+// Shared by every benchmark, including the ones that only build the parts
+// of Kwm that do not depend on Carbon. Every measurement is repeated until
+// it has run for a while, and the time of a single run is reported.
+#define BENCH_MIN_RUNS 5
+#define BENCH_MIN_MILLISECONDS 200
+
+double GetBenchMilliseconds(std::chrono::steady_clock::time_point Start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - Start).count();
+}
+
+bool ShouldBenchContinue(int Runs, std::chrono::steady_clock::time_point Start)
+{
+    return Runs < BENCH_MIN_RUNS || GetBenchMilliseconds(Start) < BENCH_MIN_MILLISECONDS;
+}
+
+std::string FormatBenchTime(double Milliseconds)
+{
+    std::ostringstream Output;
+    Output << std::fixed << std::setprecision(Milliseconds < 1 ? 2 : 1);
+    if(Milliseconds < 0.001)
+        Output << Milliseconds * 1000000 << "ns";
+    else if(Milliseconds < 1)
+        Output << Milliseconds * 1000 << "us";
+    else
+        Output << Milliseconds << "ms";
+
+    return Output.str();
+}
+
+#endif
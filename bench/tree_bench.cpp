@@ -0,0 +1,203 @@
+#include "bench.h"
+
+// Compares the node pool against allocating every node with malloc, as
+// CreateLeafNode and DestroyNodeTree did before the pool. Both sides copy
+// the same tree, built once by CreateTreeFromWindowIDList, so only the
+// allocation, the pointer chasing and the teardown differ.
+tree_node *CopyNodeTreeWithMalloc(tree_node *Node, tree_node *Parent)
+{
+    if(!Node)
+        return NULL;
+
+    tree_node *Copy = (tree_node*) malloc(sizeof(tree_node));
+    *Copy = *Node;
+    Copy->Parent = Parent;
+    Copy->LeftChild = CopyNodeTreeWithMalloc(Node->LeftChild, Copy);
+    Copy->RightChild = CopyNodeTreeWithMalloc(Node->RightChild, Copy);
+    return Copy;
+}
+
+void FreeMallocNodeTree(tree_node *Node)
+{
+    if(Node)
+    {
+        FreeMallocNodeTree(Node->LeftChild);
+        FreeMallocNodeTree(Node->RightChild);
+        free(Node);
+    }
+}
+
+tree_node *CopyNodeTreeWithPool(node_pool *Pool, tree_node *Node, tree_node *Parent)
+{
+    if(!Node)
+        return NULL;
+
+    tree_node *Copy = AllocateNode(Pool);
+    *Copy = *Node;
+    Copy->Parent = Parent;
+    Copy->LeftChild = CopyNodeTreeWithPool(Pool, Node->LeftChild, Copy);
+    Copy->RightChild = CopyNodeTreeWithPool(Pool, Node->RightChild, Copy);
+    return Copy;
+}
+
+double SumNodeTreeArea(tree_node *Node)
+{
+    if(!Node)
+        return 0;
+
+    return Node->Container.Width * Node->Container.Height +
+           SumNodeTreeArea(Node->LeftChild) +
+           SumNodeTreeArea(Node->RightChild);
+}
+
+struct tree_bench_result
+{
+    double Build;
+    double Walk;
+    double Teardown;
+};
+
+// The malloc side allocates a little in between, like the rest of Kwm did
+// while trees were built, so that nodes do not end up next to each other
+// by accident of an empty heap.
+tree_bench_result BenchMallocTree(tree_node *Source)
+{
+    tree_bench_result Result = {};
+    std::vector<void*> Noise;
+    int Runs = 0;
+    double Area = 0;
+
+    kwm_time_point Start = std::chrono::steady_clock::now();
+    while(ShouldBenchContinue(Runs, Start))
+    {
+        std::vector<void*> Batch;
+        for(int NoiseIndex = 0; NoiseIndex < 64; ++NoiseIndex)
+            Batch.push_back(malloc(16 + (NoiseIndex % 8) * 24));
+
+        kwm_time_point Phase = std::chrono::steady_clock::now();
+        tree_node *Copy = CopyNodeTreeWithMalloc(Source, NULL);
+        Result.Build += GetBenchMilliseconds(Phase);
+
+        Phase = std::chrono::steady_clock::now();
+        Area += SumNodeTreeArea(Copy);
+        Result.Walk += GetBenchMilliseconds(Phase);
+
+        Phase = std::chrono::steady_clock::now();
+        FreeMallocNodeTree(Copy);
+        Result.Teardown += GetBenchMilliseconds(Phase);
+
+        for(std::size_t NoiseIndex = 0; NoiseIndex < Batch.size(); ++NoiseIndex)
+        {
+            if(NoiseIndex % 2)
+                Noise.push_back(Batch[NoiseIndex]);
+            else
+                free(Batch[NoiseIndex]);
+        }
+
+        ++Runs;
+    }
+
+    for(std::size_t NoiseIndex = 0; NoiseIndex < Noise.size(); ++NoiseIndex)
+        free(Noise[NoiseIndex]);
+
+    if(Area < 0)
+        std::cout << Area << std::endl;
+
+    Result.Build /= Runs;
+    Result.Walk /= Runs;
+    Result.Teardown /= Runs;
+    return Result;
+}
+
+// A space keeps the blocks of its pool between trees, so the runs after
+// the first one measure the steady state of a space being re-tiled.
+tree_bench_result BenchPoolTree(tree_node *Source)
+{
+    tree_bench_result Result = {};
+    node_pool Pool = {};
+    int Runs = 0;
+    double Area = 0;
+
+    kwm_time_point Start = std::chrono::steady_clock::now();
+    while(ShouldBenchContinue(Runs, Start))
+    {
+        kwm_time_point Phase = std::chrono::steady_clock::now();
+        tree_node *Copy = CopyNodeTreeWithPool(&Pool, Source, NULL);
+        Result.Build += GetBenchMilliseconds(Phase);
+
+        Phase = std::chrono::steady_clock::now();
+        Area += SumNodeTreeArea(Copy);
+        Result.Walk += GetBenchMilliseconds(Phase);
+
+        Phase = std::chrono::steady_clock::now();
+        ResetNodePool(&Pool);
+        Result.Teardown += GetBenchMilliseconds(Phase);
+
+        ++Runs;
+    }
+
+    FreeNodePool(&Pool);
+    if(Area < 0)
+        std::cout << Area << std::endl;
+
+    Result.Build /= Runs;
+    Result.Walk /= Runs;
+    Result.Teardown /= Runs;
+    return Result;
+}
+
+// The whole of CreateTreeFromWindowIDList and DestroyNodeTree, to put the
+// allocation cost in relation to building the containers.
+double BenchCreateTree(screen_info *Screen, std::vector<window_info*> *Windows)
+{
+    space_info *Space = &Screen->Space[Screen->ActiveSpace];
+    int Runs = 0;
+    double Total = 0;
+
+    kwm_time_point Start = std::chrono::steady_clock::now();
+    while(ShouldBenchContinue(Runs, Start))
+    {
+        kwm_time_point Phase = std::chrono::steady_clock::now();
+        Space->RootNode = CreateTreeFromWindowIDList(Screen, Windows);
+        DestroyNodeTree(Space);
+        Total += GetBenchMilliseconds(Phase);
+        ++Runs;
+    }
+
+    return Total / Runs;
+}
+
+void PrintTreeBenchResult(const char *Name, tree_bench_result *Result)
+{
+    std::cout << "    " << std::left << std::setw(8) << Name
+              << "build " << std::setw(10) << FormatBenchTime(Result->Build)
+              << "walk " << std::setw(10) << FormatBenchTime(Result->Walk)
+              << "teardown " << FormatBenchTime(Result->Teardown) << std::endl;
+}
+
+int main()
+{
+    screen_info *Screen = CreateBenchScreen();
+    space_info *Space = &Screen->Space[Screen->ActiveSpace];
+
+    int LeafCounts[] = { 10, 100, 1000, 10000 };
+    for(int CountIndex = 0; CountIndex < 4; ++CountIndex)
+    {
+        int Leaves = LeafCounts[CountIndex];
+        std::vector<window_info> Windows = CreateBenchWindows(Leaves);
+        std::vector<window_info*> WindowPointers = GetBenchWindowPointers(&Windows);
+
+        double CreateTree = BenchCreateTree(Screen, &WindowPointers);
+        tree_node *Source = CreateTreeFromWindowIDList(Screen, &WindowPointers);
+        tree_bench_result Malloc = BenchMallocTree(Source);
+        tree_bench_result Pool = BenchPoolTree(Source);
+        DestroyNodeTree(Space);
+
+        std::cout << "tree_bench: " << Leaves << " leaves, CreateTreeFromWindowIDList + DestroyNodeTree "
+                  << FormatBenchTime(CreateTree) << std::endl;
+        PrintTreeBenchResult("malloc", &Malloc);
+        PrintTreeBenchResult("pool", &Pool);
+    }
+
+    return 0;
+}
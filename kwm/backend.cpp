@@ -0,0 +1,252 @@
+#include "kwm.h"
+
+extern kwm_focus KWMFocus;
+extern std::vector<window_info> WindowLst;
+
+kwm_backend KWMBackend = { AXSetWindowPosition, AXSetWindowSize };
+extern kwm_dispatch KWMDispatch;
+kwm_ax KWMAX = {};
+
+KWM_WINDOW_SET_POSITION(AXSetWindowPosition)
+{
+    CGPoint WindowPos = CGPointMake(X, Y);
+    CFTypeRef NewWindowPos = (CFTypeRef)AXValueCreate(kAXValueCGPointType, (const void*)&WindowPos);
+    if(!NewWindowPos)
+        return false;
+
+    AXError Error = SetAXAttribute(WindowRef, kAXPositionAttribute, NewWindowPos);
+    CFRelease(NewWindowPos);
+    return Error == kAXErrorSuccess;
+}
+
+KWM_WINDOW_SET_SIZE(AXSetWindowSize)
+{
+    CGSize WindowSize = CGSizeMake(Width, Height);
+    CFTypeRef NewWindowSize = (CFTypeRef)AXValueCreate(kAXValueCGSizeType, (void*)&WindowSize);
+    if(!NewWindowSize)
+        return false;
+
+    AXError Error = SetAXAttribute(WindowRef, kAXSizeAttribute, NewWindowSize);
+    CFRelease(NewWindowSize);
+    return Error == kAXErrorSuccess;
+}
+
+// Every write is a synchronous round trip to the application that owns the
+// window, so only the attributes that differ from the last known frame of
+// the window are sent. The frame in window_info is only updated for writes
+// that succeeded, which makes a failed write be retried on the next apply.
+int ApplyWindowFrame(AXUIElementRef WindowRef, window_info *Window, int X, int Y, int Width, int Height)
+{
+    frame_write Write = { Window->PID, WindowRef, Window, NULL, X, Y, Width, Height };
+
+    int Skipped = PrepareWindowFrame(&Write);
+    WriteWindowFrame(&Write);
+    if(Write.Moved || Write.Resized)
+        RecordFrameWrite(Write.PID);
+
+    if(CommitWindowFrame(&Write))
+        InvalidateWindowGrid();
+
+    return Skipped;
+}
+
+// Writes the queued frames through the apply stage in dispatch.cpp, and then
+// records the result on the nodes and in the focus cache.
+void DispatchWindowFrames()
+{
+    std::vector<frame_write> &Writes = KWMDispatch.Writes;
+    if(Writes.empty())
+        return;
+
+    kwm_time_point Start = std::chrono::steady_clock::now();
+    if(WriteWindowFrames())
+        InvalidateWindowGrid();
+
+    for(std::size_t WriteIndex = 0; WriteIndex < Writes.size(); ++WriteIndex)
+    {
+        frame_write *Write = &Writes[WriteIndex];
+        if(Write->Node)
+        {
+            Write->Node->Applied = Write->Node->Container;
+            Write->Node->Dirty = (Write->Move && !Write->Moved) || (Write->Resize && !Write->Resized);
+        }
+
+        if(Write->Moved || Write->Resized)
+            RecordFrameWrite(Write->PID);
+
+        if(WindowsAreEqual(Write->Window, KWMFocus.Window))
+            KWMFocus.Cache = *Write->Window;
+
+        DEBUG("DispatchWindowFrames() Window " << Write->Window->Name << ": " << Write->Window->X << "," << Write->Window->Y)
+    }
+
+    Writes.clear();
+    RecordLatency(StatApply, Start);
+}
+
+// Every accessibility call goes through these wrappers. The timeout set by
+// KwmSetAXTimeout bounds how long a single call may block, and is also the
+// budget that a call is measured against. An application that exceeds it
+// KWM_AX_STRIKES times in a row is quarantined: its calls fail immediately
+// until ReleaseAXQuarantine lets them through again.
+AXError CopyAXAttribute(AXUIElementRef Element, CFStringRef Attribute, CFTypeRef *Value)
+{
+    int PID;
+    if(!BeginAXCall(Element, &PID))
+        return kAXErrorCannotComplete;
+
+    kwm_time_point Start = std::chrono::steady_clock::now();
+    return EndAXCall(PID, StatAXCopy, Start, AXUIElementCopyAttributeValue(Element, Attribute, Value));
+}
+
+AXError SetAXAttribute(AXUIElementRef Element, CFStringRef Attribute, CFTypeRef Value)
+{
+    int PID;
+    if(!BeginAXCall(Element, &PID))
+        return kAXErrorCannotComplete;
+
+    kwm_time_point Start = std::chrono::steady_clock::now();
+    return EndAXCall(PID, StatAXSet, Start, AXUIElementSetAttributeValue(Element, Attribute, Value));
+}
+
+AXError PerformAXAction(AXUIElementRef Element, CFStringRef Action)
+{
+    int PID;
+    if(!BeginAXCall(Element, &PID))
+        return kAXErrorCannotComplete;
+
+    kwm_time_point Start = std::chrono::steady_clock::now();
+    return EndAXCall(PID, StatAXPerform, Start, AXUIElementPerformAction(Element, Action));
+}
+
+// The system-wide element has no pid and is accounted for as 0.
+bool BeginAXCall(AXUIElementRef Element, int *PID)
+{
+    pid_t ElementPID = 0;
+    AXUIElementGetPid(Element, &ElementPID);
+    *PID = ElementPID;
+
+    pthread_mutex_lock(&KWMAX.Lock);
+    ax_app_stats *Stats = &KWMAX.Apps[*PID];
+    bool Allowed = !Stats->Quarantined;
+    if(!Allowed)
+        ++Stats->Skipped;
+    pthread_mutex_unlock(&KWMAX.Lock);
+
+    return Allowed;
+}
+
+AXError EndAXCall(int PID, kwm_stat Stat, kwm_time_point Start, AXError Error)
+{
+    RecordLatency(Stat, Start);
+    double Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+
+    pthread_mutex_lock(&KWMAX.Lock);
+    bool Slow = Seconds >= KWMAX.Timeout;
+    ax_app_stats *Stats = &KWMAX.Apps[PID];
+    ++Stats->Calls;
+    Stats->Total += Seconds;
+    if(Seconds > Stats->Max)
+        Stats->Max = Seconds;
+
+    if(!Slow)
+    {
+        Stats->Strikes = 0;
+    }
+    else
+    {
+        ++Stats->Slow;
+        if(++Stats->Strikes >= KWM_AX_STRIKES && PID != 0 && !Stats->Quarantined)
+        {
+            Stats->Quarantined = true;
+            Stats->Until = std::chrono::steady_clock::now() +
+                           std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(KWMAX.Quarantine));
+            DEBUG("EndAXCall() Quarantined application " << PID)
+        }
+    }
+    pthread_mutex_unlock(&KWMAX.Lock);
+
+    return Error;
+}
+
+// Called by the window monitor. A released application gets a single call
+// to prove itself before it is quarantined again. Returns true if any
+// application was released, so that the frames it missed can be retried.
+bool ReleaseAXQuarantine()
+{
+    bool Released = false;
+    kwm_time_point Now = std::chrono::steady_clock::now();
+
+    pthread_mutex_lock(&KWMAX.Lock);
+    std::map<int, ax_app_stats>::iterator It;
+    for(It = KWMAX.Apps.begin(); It != KWMAX.Apps.end(); ++It)
+    {
+        ax_app_stats *Stats = &It->second;
+        if(Stats->Quarantined && Now >= Stats->Until)
+        {
+            Stats->Quarantined = false;
+            Stats->Strikes = KWM_AX_STRIKES - 1;
+            Released = true;
+            DEBUG("ReleaseAXQuarantine() Released application " << It->first)
+        }
+    }
+    pthread_mutex_unlock(&KWMAX.Lock);
+
+    return Released;
+}
+
+// Pids are reused, so a new application must not inherit the strikes or the
+// quarantine of one that terminated.
+void ForgetAXStats(int PID)
+{
+    pthread_mutex_lock(&KWMAX.Lock);
+    KWMAX.Apps.erase(PID);
+    pthread_mutex_unlock(&KWMAX.Lock);
+}
+
+void KwmSetAXTimeout(double Seconds)
+{
+    AXUIElementRef SystemWideElement = AXUIElementCreateSystemWide();
+    if(AXUIElementSetMessagingTimeout(SystemWideElement, Seconds) == kAXErrorSuccess)
+    {
+        pthread_mutex_lock(&KWMAX.Lock);
+        KWMAX.Timeout = Seconds;
+        pthread_mutex_unlock(&KWMAX.Lock);
+    }
+
+    CFRelease(SystemWideElement);
+}
+
+std::string GetAXLatencyReport()
+{
+    pthread_mutex_lock(&KWMAX.Lock);
+    std::string Output = "timeout " + std::to_string(KWMAX.Timeout) + "s";
+    std::map<int, ax_app_stats>::iterator It;
+    for(It = KWMAX.Apps.begin(); It != KWMAX.Apps.end(); ++It)
+    {
+        ax_app_stats *Stats = &It->second;
+        std::string Owner = It->first == 0 ? "system" : "unknown";
+        for(std::size_t WindowIndex = 0; WindowIndex < WindowLst.size(); ++WindowIndex)
+        {
+            if(WindowLst[WindowIndex].PID == It->first)
+            {
+                Owner = GetWindowOwner(&WindowLst[WindowIndex]);
+                break;
+            }
+        }
+
+        double Average = Stats->Calls ? Stats->Total / Stats->Calls : 0;
+        Output += "\n" + std::to_string(It->first) + " " + Owner +
+                  ": calls " + std::to_string(Stats->Calls) +
+                  ", avg " + std::to_string(Average * 1000) + "ms" +
+                  ", max " + std::to_string(Stats->Max * 1000) + "ms" +
+                  ", slow " + std::to_string(Stats->Slow) +
+                  ", skipped " + std::to_string(Stats->Skipped);
+
+        if(Stats->Quarantined)
+            Output += ", quarantined";
+    }
+    pthread_mutex_unlock(&KWMAX.Lock);
+
+    return Output;
+}
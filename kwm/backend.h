@@ -0,0 +1,82 @@
+#ifndef KWM_BACKEND_H
+#define KWM_BACKEND_H
+
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include <pthread.h>
+
+// The apply stage does not depend on Carbon, so that it can be built and
+// tested on its own with a fake backend. The window reference is only
+// passed through, which is why it is enough to name the type here.
+typedef const struct __AXUIElement *AXUIElementRef;
+struct tree_node;
+
+struct window_info;
+struct kwm_backend;
+struct frame_write;
+struct kwm_dispatch;
+
+#define KWM_WINDOW_SET_POSITION(name) bool name(AXUIElementRef WindowRef, int X, int Y)
+typedef KWM_WINDOW_SET_POSITION(kwm_window_set_position);
+
+#define KWM_WINDOW_SET_SIZE(name) bool name(AXUIElementRef WindowRef, int Width, int Height)
+typedef KWM_WINDOW_SET_SIZE(kwm_window_set_size);
+
+struct window_info
+{
+    std::string Name;
+    int OwnerID;
+    int PID, WID;
+    int Layer;
+    int X, Y;
+    int Width, Height;
+};
+
+struct kwm_backend
+{
+    kwm_window_set_position *SetWindowPosition;
+    kwm_window_set_size *SetWindowSize;
+
+    unsigned int Writes;
+    unsigned int SkippedWrites;
+};
+
+struct frame_write
+{
+    int PID;
+    AXUIElementRef WindowRef;
+    window_info *Window;
+    tree_node *Node;
+    int X, Y, Width, Height;
+
+    bool Move, Resize;
+    bool Moved, Resized;
+};
+
+#define KWM_DISPATCH_THREADS 4
+struct kwm_dispatch
+{
+    pthread_mutex_t Lock;
+    pthread_cond_t Work;
+    pthread_cond_t Done;
+    pthread_t Threads[KWM_DISPATCH_THREADS];
+    bool Started;
+
+    std::vector<frame_write> Writes;
+    std::vector<std::size_t> Groups;
+    std::size_t NextGroup;
+    std::size_t PendingGroups;
+};
+
+int PrepareWindowFrame(frame_write *);
+void WriteWindowFrame(frame_write *);
+bool CommitWindowFrame(frame_write *);
+bool WriteWindowFrames();
+bool IsFrameWriteOfLowerPID(const frame_write &, const frame_write &);
+bool RunWindowFrameGroup();
+void * KwmDispatchWorker(void *);
+bool KwmStartDispatchPool();
+
+#endif
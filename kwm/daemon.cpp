@@ -1,5 +1,9 @@
 #include "kwm.h"
 
+extern kwm_screen KWMScreen;
+
+kwm_commands KWMCommands = {};
+
 int KwmSockFD;
 bool KwmDaemonIsRunning;
 int KwmDaemonPort = 3020;
@@ -40,11 +44,78 @@ void KwmDaemonHandleConnection()
     if(ClientSockFD != -1)
     {
         std::string Message = KwmReadFromSocket(ClientSockFD);
-        KwmInterpretCommand(Message, ClientSockFD);
+        if(Message.compare(0, 5, "read ") == 0)
+        {
+            std::future<std::string> Reply;
+            KwmQueueCommand(Message, &Reply);
+            KwmWriteToSocket(ClientSockFD, Reply.get());
+        }
+        else
+        {
+            KwmQueueCommand(Message, NULL);
+        }
+
         close(ClientSockFD);
     }
 }
 
+// Commands from kwmc and from hotkeys are pushed onto a lock-free stack and
+// executed by the window monitor, which is the only thread that changes the
+// window trees. Commands that expect a reply get it through the future.
+void KwmQueueCommand(const std::string &Text, std::future<std::string> *Reply)
+{
+    kwm_command *Command = new kwm_command;
+    Command->Text = Text;
+    Command->Reply = Reply != NULL;
+    if(Reply)
+        *Reply = Command->Result.get_future();
+
+    Command->Next = KWMCommands.Head.load(std::memory_order_relaxed);
+    while(!KWMCommands.Head.compare_exchange_weak(Command->Next, Command,
+                                                  std::memory_order_release,
+                                                  std::memory_order_relaxed));
+
+    WakeWindowMonitor();
+}
+
+// Runs every command queued so far, in the order they were queued, as one
+// batch with BackgroundLock held. Windows are only moved once at the end of
+// the batch, however many commands changed the layout.
+bool KwmRunQueuedCommands()
+{
+    kwm_command *Command = KWMCommands.Head.exchange(NULL, std::memory_order_acquire);
+    if(!Command)
+        return false;
+
+    kwm_command *Batch = NULL;
+    while(Command)
+    {
+        kwm_command *Next = Command->Next;
+        Command->Next = Batch;
+        Batch = Command;
+        Command = Next;
+    }
+
+    KWMScreen.DeferApply = true;
+    while(Batch)
+    {
+        std::string Reply;
+        KwmInterpretCommand(Batch->Text, Batch->Reply ? &Reply : NULL);
+        if(Batch->Reply)
+            Batch->Result.set_value(Reply);
+
+        kwm_command *Next = Batch->Next;
+        delete Batch;
+        Batch = Next;
+        ++KWMCommands.Executed;
+    }
+
+    KWMScreen.DeferApply = false;
+    ApplyDeferredNodeContainers();
+    ++KWMCommands.Batches;
+    return true;
+}
+
 void KwmTerminateDaemon()
 {
     KwmDaemonIsRunning = false;
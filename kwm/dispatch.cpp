@@ -0,0 +1,156 @@
+#include "backend.h"
+
+extern kwm_backend KWMBackend;
+kwm_dispatch KWMDispatch = {};
+
+int PrepareWindowFrame(frame_write *Write)
+{
+    window_info *Window = Write->Window;
+    Write->Move = Window->X != Write->X || Window->Y != Write->Y;
+    Write->Resize = Window->Width != Write->Width || Window->Height != Write->Height;
+    Write->Moved = Write->Resized = false;
+
+    int Skipped = !Write->Move + !Write->Resize;
+    KWMBackend.Writes += 2 - Skipped;
+    KWMBackend.SkippedWrites += Skipped;
+    return Skipped;
+}
+
+// Only talks to the application, so that writes to different applications
+// can run on the dispatch pool while BackgroundLock is held by the caller.
+void WriteWindowFrame(frame_write *Write)
+{
+    if(Write->Move)
+        Write->Moved = KWMBackend.SetWindowPosition(Write->WindowRef, Write->X, Write->Y);
+
+    if(Write->Resize)
+        Write->Resized = KWMBackend.SetWindowSize(Write->WindowRef, Write->Width, Write->Height);
+}
+
+bool CommitWindowFrame(frame_write *Write)
+{
+    window_info *Window = Write->Window;
+    if(Write->Moved)
+    {
+        Window->X = Write->X;
+        Window->Y = Write->Y;
+    }
+
+    if(Write->Resized)
+    {
+        Window->Width = Write->Width;
+        Window->Height = Write->Height;
+    }
+
+    return Write->Move || Write->Resize;
+}
+
+// Frame writes queued by QueueWindowFrame are grouped by the application that
+// owns the window. Each group keeps its queued order and runs on one thread,
+// while different applications run in parallel, so a slow application only
+// delays its own windows. Returns once every group has been written and
+// committed, and whether any window was sent a new frame.
+bool WriteWindowFrames()
+{
+    std::vector<frame_write> &Writes = KWMDispatch.Writes;
+    std::stable_sort(Writes.begin(), Writes.end(), IsFrameWriteOfLowerPID);
+
+    std::vector<std::size_t> Groups;
+    for(std::size_t WriteIndex = 0; WriteIndex < Writes.size(); ++WriteIndex)
+    {
+        PrepareWindowFrame(&Writes[WriteIndex]);
+        if(WriteIndex == 0 || Writes[WriteIndex].PID != Writes[WriteIndex - 1].PID)
+            Groups.push_back(WriteIndex);
+    }
+
+    if(!KWMDispatch.Started || Groups.size() <= 1)
+    {
+        for(std::size_t WriteIndex = 0; WriteIndex < Writes.size(); ++WriteIndex)
+            WriteWindowFrame(&Writes[WriteIndex]);
+    }
+    else
+    {
+        Groups.push_back(Writes.size());
+
+        pthread_mutex_lock(&KWMDispatch.Lock);
+        KWMDispatch.Groups.swap(Groups);
+        KWMDispatch.NextGroup = 0;
+        KWMDispatch.PendingGroups = KWMDispatch.Groups.size() - 1;
+        pthread_cond_broadcast(&KWMDispatch.Work);
+        pthread_mutex_unlock(&KWMDispatch.Lock);
+
+        while(RunWindowFrameGroup());
+
+        pthread_mutex_lock(&KWMDispatch.Lock);
+        while(KWMDispatch.PendingGroups != 0)
+            pthread_cond_wait(&KWMDispatch.Done, &KWMDispatch.Lock);
+        pthread_mutex_unlock(&KWMDispatch.Lock);
+    }
+
+    bool Changed = false;
+    for(std::size_t WriteIndex = 0; WriteIndex < Writes.size(); ++WriteIndex)
+    {
+        if(CommitWindowFrame(&Writes[WriteIndex]))
+            Changed = true;
+    }
+
+    return Changed;
+}
+
+bool IsFrameWriteOfLowerPID(const frame_write &A, const frame_write &B)
+{
+    return A.PID < B.PID;
+}
+
+// Claims the next group that has not been written yet and writes it. Called
+// by the dispatch pool and by the thread that dispatched the writes.
+bool RunWindowFrameGroup()
+{
+    pthread_mutex_lock(&KWMDispatch.Lock);
+    if(KWMDispatch.NextGroup + 1 >= KWMDispatch.Groups.size())
+    {
+        pthread_mutex_unlock(&KWMDispatch.Lock);
+        return false;
+    }
+
+    std::size_t Group = KWMDispatch.NextGroup++;
+    std::size_t First = KWMDispatch.Groups[Group];
+    std::size_t Last = KWMDispatch.Groups[Group + 1];
+    pthread_mutex_unlock(&KWMDispatch.Lock);
+
+    for(std::size_t WriteIndex = First; WriteIndex < Last; ++WriteIndex)
+        WriteWindowFrame(&KWMDispatch.Writes[WriteIndex]);
+
+    pthread_mutex_lock(&KWMDispatch.Lock);
+    if(--KWMDispatch.PendingGroups == 0)
+        pthread_cond_signal(&KWMDispatch.Done);
+    pthread_mutex_unlock(&KWMDispatch.Lock);
+    return true;
+}
+
+void * KwmDispatchWorker(void *)
+{
+    while(1)
+    {
+        pthread_mutex_lock(&KWMDispatch.Lock);
+        while(KWMDispatch.NextGroup + 1 >= KWMDispatch.Groups.size())
+            pthread_cond_wait(&KWMDispatch.Work, &KWMDispatch.Lock);
+        pthread_mutex_unlock(&KWMDispatch.Lock);
+
+        while(RunWindowFrameGroup());
+    }
+}
+
+bool KwmStartDispatchPool()
+{
+    if(pthread_mutex_init(&KWMDispatch.Lock, NULL) != 0 ||
+       pthread_cond_init(&KWMDispatch.Work, NULL) != 0 ||
+       pthread_cond_init(&KWMDispatch.Done, NULL) != 0)
+        return false;
+
+    for(int ThreadIndex = 0; ThreadIndex < KWM_DISPATCH_THREADS; ++ThreadIndex)
+        pthread_create(&KWMDispatch.Threads[ThreadIndex], NULL, &KwmDispatchWorker, NULL);
+
+    KWMDispatch.Started = true;
+    return true;
+}
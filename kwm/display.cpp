@@ -5,7 +5,6 @@ extern kwm_focus KWMFocus;
 extern pthread_mutex_t BackgroundLock;
 
 extern std::map<unsigned int, screen_info> DisplayMap;
-extern std::map<std::string, int> CapturedAppLst;
 extern std::vector<window_info> WindowLst;
 
 void DisplayReconfigurationCallBack(CGDirectDisplayID Display, CGDisplayChangeSummaryFlags Flags, void *UserInfo)
@@ -24,13 +23,15 @@ void DisplayReconfigurationCallBack(CGDirectDisplayID Display, CGDisplayChangeSu
         DEBUG("Display has been removed! DisplayID: " << Display)
         std::map<int, space_info>::iterator It;
         for(It = DisplayMap[Display].Space.begin(); It != DisplayMap[Display].Space.end(); ++It)
-            DestroyNodeTree(It->second.RootNode, It->second.Mode);
+            FreeNodePool(&It->second.Pool);
 
         DisplayMap.erase(Display);
         RefreshActiveDisplays();
     }
 
+    PublishTapState();
     pthread_mutex_unlock(&BackgroundLock);
+    PushWindowEvent(DisplayEventChanged, 0, -1);
 }
 
 screen_info CreateDefaultScreenInfo(int DisplayIndex, int ScreenIndex)
@@ -41,7 +42,7 @@ screen_info CreateDefaultScreenInfo(int DisplayIndex, int ScreenIndex)
     Screen.ID = ScreenIndex;
     Screen.ForceContainerUpdate = false;
     Screen.ActiveSpace = -1;
-    Screen.OldWindowListCount = -1;
+    Screen.OldWindowListValid = false;
 
     Screen.X = DisplayRect.origin.x;
     Screen.Y = DisplayRect.origin.y;
@@ -105,6 +106,33 @@ void RefreshActiveDisplays()
     KWMScreen.Current = GetDisplayOfMousePointer();
 }
 
+// While KWMScreen.DeferApply is set, ApplyNodeContainer leaves windows where
+// they are. Every node remembers the frame it last applied, so one pass over
+// the active space of each screen afterwards moves each window only once.
+// Pending rotations are resolved first, so that they are part of that pass.
+void ApplyDeferredNodeContainers()
+{
+    bool DeferApply = KWMScreen.DeferApply;
+    KWMScreen.DeferApply = true;
+
+    std::map<unsigned int, screen_info>::iterator It;
+    for(It = DisplayMap.begin(); It != DisplayMap.end(); ++It)
+        ApplyPendingTreeRotation(&It->second);
+
+    KWMScreen.DeferApply = DeferApply;
+    for(It = DisplayMap.begin(); It != DisplayMap.end(); ++It)
+    {
+        screen_info *Screen = &It->second;
+        if(DoesSpaceExistInMapOfScreen(Screen))
+        {
+            space_info *Space = &Screen->Space[Screen->ActiveSpace];
+            QueueNodeContainer(Space->RootNode, Space->Mode);
+        }
+    }
+
+    DispatchWindowFrames();
+}
+
 screen_info *GetDisplayFromScreenID(unsigned int ID)
 {
     std::map<unsigned int, screen_info>::iterator It;
@@ -149,6 +177,30 @@ screen_info *GetDisplayOfWindow(window_info *Window)
     return NULL;
 }
 
+void GetDisplayBounds(std::vector<display_bounds> *Displays)
+{
+    Displays->clear();
+    std::map<unsigned int, screen_info>::iterator It;
+    for(It = DisplayMap.begin(); It != DisplayMap.end(); ++It)
+    {
+        screen_info *Screen = &It->second;
+        display_bounds Bounds = { Screen, (double)Screen->X, Screen->X + Screen->Width };
+        Displays->push_back(Bounds);
+    }
+}
+
+screen_info *GetDisplayOfWindow(std::vector<display_bounds> *Displays, window_info *Window)
+{
+    for(std::size_t DisplayIndex = 0; DisplayIndex < Displays->size(); ++DisplayIndex)
+    {
+        display_bounds *Bounds = &(*Displays)[DisplayIndex];
+        if(Window->X >= Bounds->Left && Window->X <= Bounds->Right)
+            return Bounds->Screen;
+    }
+
+    return NULL;
+}
+
 std::vector<window_info*> GetAllWindowsOnDisplay(int ScreenIndex)
 {
     screen_info *Screen = GetDisplayFromScreenID(ScreenIndex);
@@ -386,7 +438,7 @@ void GiveFocusToScreen(int ScreenIndex, tree_node *Focus, bool Mouse)
 
                 if(Mouse && KWMFocus.Window)
                 {
-                    if(IsWindowFloating(KWMFocus.Window->WID, NULL))
+                    if(IsWindowFloating(KWMFocus.Window->WID))
                         ToggleFocusedWindowFloating();
                 }
             }
@@ -396,13 +448,14 @@ void GiveFocusToScreen(int ScreenIndex, tree_node *Focus, bool Mouse)
 
 void CaptureApplicationToScreen(int ScreenID, std::string Application)
 {
-    std::map<std::string, int>::iterator It = CapturedAppLst.find(Application);
-    if(It == CapturedAppLst.end())
+    app_rule *Rule = CreateApplicationRule(Application);
+    if(!(Rule->Flags & AppRuleCaptured))
     {
         screen_info *Screen = GetDisplayFromScreenID(ScreenID);
         if(Screen)
         {
-            CapturedAppLst[Application] = ScreenID;
+            Rule->Flags |= AppRuleCaptured;
+            Rule->CapturedScreen = ScreenID;
             DEBUG("CaptureApplicationToScreen() " << ScreenID << " " << Application)
         }
     }
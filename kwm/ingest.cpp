@@ -0,0 +1,52 @@
+#include "ingest.h"
+
+extern kwm_window_reader KWMReader;
+window_owners KWMOwners;
+
+// Every field of the window is overwritten, so that the entries of a reused
+// window list only allocate when a name outgrows its buffer.
+void GetWindowInfo(const void *Entry, window_info *Window)
+{
+    int WID = 0, PID = 0, Layer = 0;
+    KWMReader.GetNumber(Entry, WindowKeyNumber, &WID);
+    KWMReader.GetNumber(Entry, WindowKeyOwnerPID, &PID);
+    KWMReader.GetNumber(Entry, WindowKeyLayer, &Layer);
+
+    Window->WID = WID;
+    Window->PID = PID;
+    Window->Layer = Layer;
+
+    int X = 0, Y = 0, Width = 0, Height = 0;
+    KWMReader.GetBounds(Entry, &X, &Y, &Width, &Height);
+    Window->X = X;
+    Window->Y = Y;
+    Window->Width = Width;
+    Window->Height = Height;
+
+    const char *Name = KWMReader.GetString(Entry, WindowKeyName);
+    const char *Owner = KWMReader.GetString(Entry, WindowKeyOwnerName);
+    Window->Name.assign(Name ? Name : "");
+    Window->OwnerID = GetWindowOwnerID(Owner ? Owner : "");
+}
+
+int GetWindowOwnerID(const char *Owner)
+{
+    KWMOwners.Key.assign(Owner);
+    std::unordered_map<std::string, int>::iterator It = KWMOwners.IDs.find(KWMOwners.Key);
+    if(It != KWMOwners.IDs.end())
+        return It->second;
+
+    int OwnerID = KWMOwners.Names.size();
+    KWMOwners.Names.push_back(KWMOwners.Key);
+    KWMOwners.IDs[KWMOwners.Key] = OwnerID;
+    ++KWMOwners.Allocations;
+    return OwnerID;
+}
+
+const std::string &GetWindowOwner(window_info *Window)
+{
+    if(Window->OwnerID < 0 || Window->OwnerID >= (int)KWMOwners.Names.size())
+        return KWMOwners.NoOwner;
+
+    return KWMOwners.Names[Window->OwnerID];
+}
@@ -0,0 +1,54 @@
+#ifndef KWM_INGEST_H
+#define KWM_INGEST_H
+
+#include "backend.h"
+
+#include <unordered_map>
+
+// Reading an entry of the window list does not depend on Carbon, so that it
+// can be benchmarked on its own against recorded window lists. An entry is
+// only passed through to the reader, which looks up the few keys that Kwm
+// uses; window.cpp reads the dictionaries of CGWindowListCopyWindowInfo.
+struct kwm_window_reader;
+struct window_owners;
+
+enum window_key
+{
+    WindowKeyNumber,
+    WindowKeyOwnerPID,
+    WindowKeyLayer,
+    WindowKeyName,
+    WindowKeyOwnerName
+};
+
+#define KWM_WINDOW_GET_NUMBER(name) bool name(const void *Entry, window_key Key, int *Value)
+typedef KWM_WINDOW_GET_NUMBER(kwm_window_get_number);
+
+#define KWM_WINDOW_GET_STRING(name) const char *name(const void *Entry, window_key Key)
+typedef KWM_WINDOW_GET_STRING(kwm_window_get_string);
+
+#define KWM_WINDOW_GET_BOUNDS(name) bool name(const void *Entry, int *X, int *Y, int *Width, int *Height)
+typedef KWM_WINDOW_GET_BOUNDS(kwm_window_get_bounds);
+
+struct kwm_window_reader
+{
+    kwm_window_get_number *GetNumber;
+    kwm_window_get_string *GetString;
+    kwm_window_get_bounds *GetBounds;
+};
+
+struct window_owners
+{
+    std::vector<std::string> Names;
+    std::unordered_map<std::string, int> IDs;
+    std::string Key;
+    std::string NoOwner;
+
+    unsigned int Allocations;
+};
+
+void GetWindowInfo(const void *, window_info *);
+int GetWindowOwnerID(const char *);
+const std::string &GetWindowOwner(window_info *);
+
+#endif
@@ -8,7 +8,6 @@ extern focus_option KwmFocusMode;
 extern space_tiling_option KwmSpaceMode;
 extern cycle_focus_option KwmCycleMode;
 
-extern std::vector<std::string> FloatingAppLst;
 
 std::string CreateStringFromTokens(std::vector<std::string> Tokens, int StartIndex)
 {
@@ -53,6 +52,14 @@ void KwmConfigCommand(std::vector<std::string> &Tokens)
         Stream >> Value;
         KwmSetGlobalPrefixTimeout(Value);
     }
+    else if(Tokens[1] == "ax-timeout")
+    {
+        double Value = 0;
+        std::stringstream Stream(Tokens[2]);
+        Stream >> Value;
+        if(Value > 0)
+            KwmSetAXTimeout(Value);
+    }
     else  if(Tokens[1] == "launchd")
     {
         if(Tokens[2] == "disable")
@@ -107,6 +114,13 @@ void KwmConfigCommand(std::vector<std::string> &Tokens)
             KwmFocusMode = FocusModeAutoraise;
         else if(Tokens[2] == "disabled")
             KwmFocusMode = FocusModeDisabled;
+        else if(Tokens[2] == "dwell")
+        {
+            double Value = 0;
+            std::stringstream Stream(Tokens[3]);
+            Stream >> Value;
+            KwmSetFocusDwell(Value);
+        }
     }
     else if(Tokens[1] == "cycle-focus")
     {
@@ -140,7 +154,7 @@ void KwmConfigCommand(std::vector<std::string> &Tokens)
     }
     else if(Tokens[1] == "float")
     {
-        FloatingAppLst.push_back(CreateStringFromTokens(Tokens, 2));
+        FloatApplication(CreateStringFromTokens(Tokens, 2));
     }
     else if(Tokens[1] == "add-role")
     {
@@ -176,7 +190,7 @@ void KwmConfigCommand(std::vector<std::string> &Tokens)
     }
 }
 
-void KwmReadCommand(std::vector<std::string> &Tokens, int ClientSockFD)
+void KwmReadCommand(std::vector<std::string> &Tokens, std::string *Reply)
 {
     if(Tokens[1] == "focused")
     {
@@ -184,26 +198,26 @@ void KwmReadCommand(std::vector<std::string> &Tokens, int ClientSockFD)
         GetTagForCurrentSpace(Output);
 
         if(KWMFocus.Window)
-            Output += " " + KWMFocus.Window->Owner + " - " + KWMFocus.Window->Name;
+            Output += " " + GetWindowOwner(KWMFocus.Window) + " - " + KWMFocus.Window->Name;
 
-        KwmWriteToSocket(ClientSockFD, Output);
+        *Reply = Output;
     }
     if(Tokens[1] == "marked")
     {
         std::string Output = std::to_string(KWMScreen.MarkedWindow);;
-        KwmWriteToSocket(ClientSockFD, Output);
+        *Reply = Output;
     }
     else if(Tokens[1] == "tag")
     {
         std::string Output;
         GetTagForCurrentSpace(Output);
-        KwmWriteToSocket(ClientSockFD, Output);
+        *Reply = Output;
     }
     else if(Tokens[1] == "split-ratio")
     {
         std::string Output = std::to_string(KWMScreen.SplitRatio);
         Output.erase(Output.find_last_not_of('0') + 1, std::string::npos);
-        KwmWriteToSocket(ClientSockFD, Output);
+        *Reply = Output;
     }
     else if(Tokens[1] == "split-mode")
     {
@@ -215,7 +229,7 @@ void KwmReadCommand(std::vector<std::string> &Tokens, int ClientSockFD)
         else if(KWMScreen.SplitMode == 2)
             Output = "Horizontal";
 
-        KwmWriteToSocket(ClientSockFD, Output);
+        *Reply = Output;
     }
     else if(Tokens[1] == "focus")
     {
@@ -227,7 +241,7 @@ void KwmReadCommand(std::vector<std::string> &Tokens, int ClientSockFD)
         else if(KwmFocusMode == FocusModeDisabled)
             Output = "disabled";
 
-        KwmWriteToSocket(ClientSockFD, Output);
+        *Reply = Output;
     }
     else if(Tokens[1] == "mouse-follows")
     {
@@ -237,7 +251,7 @@ void KwmReadCommand(std::vector<std::string> &Tokens, int ClientSockFD)
         else 
             Output = "disabled";
 
-        KwmWriteToSocket(ClientSockFD, Output);
+        *Reply = Output;
     }
     else if(Tokens[1] == "space")
     {
@@ -249,7 +263,19 @@ void KwmReadCommand(std::vector<std::string> &Tokens, int ClientSockFD)
         else 
             Output = "float";
 
-        KwmWriteToSocket(ClientSockFD, Output);
+        *Reply = Output;
+    }
+    else if(Tokens[1] == "tap-latency")
+    {
+        *Reply = GetTapLatencyHistogram();
+    }
+    else if(Tokens[1] == "ax-latency")
+    {
+        *Reply = GetAXLatencyReport();
+    }
+    else if(Tokens[1] == "stats")
+    {
+        *Reply = GetStatsReport();
     }
     else if(Tokens[1] == "cycle-focus")
     {
@@ -261,7 +287,7 @@ void KwmReadCommand(std::vector<std::string> &Tokens, int ClientSockFD)
         else 
             Output = "disabled";
 
-        KwmWriteToSocket(ClientSockFD, Output);
+        *Reply = Output;
     }
 }
 
@@ -283,7 +309,7 @@ void KwmWindowCommand(std::vector<std::string> &Tokens)
         if(Tokens[2] == "split")
         {
             space_info *Space = &KWMScreen.Current->Space[KWMScreen.Current->ActiveSpace];
-            tree_node *Node = GetNodeFromWindowID(Space->RootNode, KWMFocus.Window->WID, Space->Mode);
+            tree_node *Node = GetNodeFromWindowID(Space, KWMFocus.Window->WID);
             ToggleNodeSplitMode(KWMScreen.Current, Node->Parent);
         }
         else if(Tokens[2] == "reduce" || Tokens[2] == "expand")
@@ -332,13 +358,7 @@ void KwmTreeCommand(std::vector<std::string> &Tokens)
             std::stringstream Stream(Tokens[2]);
             Stream >> Deg;
 
-            space_info *Space = &KWMScreen.Current->Space[KWMScreen.Current->ActiveSpace];
-            if(Space->Mode == SpaceModeBSP)
-            {
-                RotateTree(Space->RootNode, Deg);
-                CreateNodeContainers(KWMScreen.Current, Space->RootNode, false);
-                ApplyNodeContainer(Space->RootNode, Space->Mode);
-            }
+            RotateWindowTree(KWMScreen.Current, Deg);
         }
     }
     else if(Tokens[1] == "-c")
@@ -346,6 +366,7 @@ void KwmTreeCommand(std::vector<std::string> &Tokens)
         if(Tokens[2] == "refresh")
         {
             space_info *Space = &KWMScreen.Current->Space[KWMScreen.Current->ActiveSpace];
+            MarkNodeContainersDirty(Space->RootNode, Space->Mode);
             ApplyNodeContainer(Space->RootNode, Space->Mode);
         }
     }
@@ -357,6 +378,14 @@ void KwmTreeCommand(std::vector<std::string> &Tokens)
     {
         LoadBSPTreeFromFile(KWMScreen.Current, Tokens[2]);
     }
+    else if(Tokens[1] == "convert")
+    {
+        ConvertBSPTreeFile(Tokens[2], Tokens[3]);
+    }
+    else if(Tokens[1] == "preload")
+    {
+        PreloadLayoutTemplates();
+    }
 }
 
 void KwmScreenCommand(std::vector<std::string> &Tokens)
@@ -458,16 +487,21 @@ void KwmBindCommand(std::vector<std::string> &Tokens)
 }
 // ------------------------------------------------------------------------------------
 
-void KwmInterpretCommand(std::string Message, int ClientSockFD)
+void KwmInterpretCommand(std::string Message, std::string *Reply)
 {
+    kwm_time_point Start = std::chrono::steady_clock::now();
     std::vector<std::string> Tokens = SplitString(Message, ' ');
 
+    if(Tokens[0] == "window" || Tokens[0] == "screen" || Tokens[0] == "space" ||
+       (Tokens[0] == "tree" && (Tokens.size() < 2 || Tokens[1] != "-r")))
+        ApplyPendingTreeRotation(KWMScreen.Current);
+
     if(Tokens[0] == "quit")
         KwmQuit();
     else if(Tokens[0] == "config")
         KwmConfigCommand(Tokens);
-    else if(Tokens[0] == "read")
-        KwmReadCommand(Tokens, ClientSockFD);
+    else if(Tokens[0] == "read" && Reply)
+        KwmReadCommand(Tokens, Reply);
     else if(Tokens[0] == "window")
         KwmWindowCommand(Tokens);
     else if(Tokens[0] == "screen")
@@ -482,4 +516,26 @@ void KwmInterpretCommand(std::string Message, int ClientSockFD)
         KwmBindCommand(Tokens);
     else if(Tokens[0] == "unbind")
         KwmRemoveHotkey(Tokens[1]);
+    else if(Tokens[0] == "stats" && Tokens.size() > 1 && Tokens[1] == "reset")
+        ResetStats();
+
+    RecordLatency(GetCommandStat(Tokens[0]), Start);
+}
+
+kwm_stat GetCommandStat(const std::string &Command)
+{
+    if(Command == "config")
+        return StatCommandConfig;
+    else if(Command == "read")
+        return StatCommandRead;
+    else if(Command == "window")
+        return StatCommandWindow;
+    else if(Command == "screen")
+        return StatCommandScreen;
+    else if(Command == "space")
+        return StatCommandSpace;
+    else if(Command == "tree")
+        return StatCommandTree;
+    else
+        return StatCommandOther;
 }
@@ -4,7 +4,7 @@ extern std::vector<hotkey> KwmHotkeys;
 extern kwm_prefix KWMPrefix;
 extern kwm_focus KWMFocus;
 
-bool HotkeysAreEqual(hotkey *A, hotkey *B)
+bool HotkeysAreEqual(const hotkey *A, const hotkey *B)
 {
     if(A && B)
     {
@@ -19,7 +19,7 @@ bool HotkeysAreEqual(hotkey *A, hotkey *B)
     return false;
 }
 
-bool KwmMainHotkeyTrigger(CGEventRef *Event)
+bool KwmMainHotkeyTrigger(const tap_state *State, CGEventRef *Event)
 {
     modifiers Mod = {};
     CGEventFlags Flags = CGEventGetFlags(*Event);
@@ -29,20 +29,20 @@ bool KwmMainHotkeyTrigger(CGEventRef *Event)
     Mod.ShiftKey = (Flags & kCGEventFlagMaskShift) == kCGEventFlagMaskShift;
     CGKeyCode Keycode = (CGKeyCode)CGEventGetIntegerValueField(*Event, kCGKeyboardEventKeycode);
 
-    if(KWMPrefix.Enabled && KwmIsPrefixKey(&KWMPrefix.Key, &Mod, Keycode))
+    if(State->PrefixEnabled && KwmIsPrefixKey(&State->PrefixKey, &Mod, Keycode))
     {
         KWMPrefix.Active = true;
         KWMPrefix.Time = std::chrono::steady_clock::now();
         return true;
     }
 
-    if(!KWMPrefix.Enabled || KWMPrefix.Active)
+    if(!State->PrefixEnabled || KWMPrefix.Active)
     {
         if(KWMPrefix.Active)
         {
             kwm_time_point NewPrefixTime = std::chrono::steady_clock::now();
             std::chrono::duration<double> Diff = NewPrefixTime - KWMPrefix.Time;
-            if(Diff.count() > KWMPrefix.Timeout)
+            if(Diff.count() > State->PrefixTimeout)
             {
                 KWMPrefix.Active = false;
                 return false;
@@ -50,7 +50,7 @@ bool KwmMainHotkeyTrigger(CGEventRef *Event)
         }
 
         // Hotkeys bound using `kwmc bind keys command`
-        if(KwmExecuteHotkey(Mod, Keycode))
+        if(KwmExecuteHotkey(State, Mod, Keycode))
         {
             if(KWMPrefix.Active)
                 KWMPrefix.Time = std::chrono::steady_clock::now();
@@ -71,7 +71,7 @@ bool KwmMainHotkeyTrigger(CGEventRef *Event)
     return false;
 }
 
-bool KwmIsPrefixKey(hotkey *PrefixKey, modifiers *Mod, CGKeyCode Keycode)
+bool KwmIsPrefixKey(const hotkey *PrefixKey, modifiers *Mod, CGKeyCode Keycode)
 {
     hotkey TempHotkey;
     TempHotkey.Mod = *Mod;
@@ -80,18 +80,21 @@ bool KwmIsPrefixKey(hotkey *PrefixKey, modifiers *Mod, CGKeyCode Keycode)
     return HotkeysAreEqual(PrefixKey, &TempHotkey);
 }
 
-bool KwmExecuteHotkey(modifiers Mod, CGKeyCode Keycode)
+// Commands bound to a hotkey change state guarded by BackgroundLock, so the
+// event tap queues them for the window monitor instead of running them itself.
+// System commands block until they exit and run on the input monitor.
+bool KwmExecuteHotkey(const tap_state *State, modifiers Mod, CGKeyCode Keycode)
 {
     hotkey Hotkey = {};
-    if(HotkeyExists(Mod, Keycode, &Hotkey))
+    if(HotkeyExists(&State->Hotkeys, Mod, Keycode, &Hotkey))
     {
         if(Hotkey.Command.empty())
             return true;
 
         if(Hotkey.IsSystemCommand)
-            system(Hotkey.Command.c_str());
+            PushTapAction(TapActionSystemCommand, Hotkey.Command);
         else
-            KwmInterpretCommand(Hotkey.Command, 0);
+            KwmQueueCommand(Hotkey.Command, NULL);
 
         return true;
     }
@@ -99,18 +102,18 @@ bool KwmExecuteHotkey(modifiers Mod, CGKeyCode Keycode)
     return false;
 }
 
-bool HotkeyExists(modifiers Mod, CGKeyCode Keycode, hotkey *Hotkey)
+bool HotkeyExists(const std::vector<hotkey> *Hotkeys, modifiers Mod, CGKeyCode Keycode, hotkey *Hotkey)
 {
     hotkey TempHotkey;
     TempHotkey.Mod = Mod;
     TempHotkey.Key = Keycode;
 
-    for(std::size_t HotkeyIndex = 0; HotkeyIndex < KwmHotkeys.size(); ++HotkeyIndex)
+    for(std::size_t HotkeyIndex = 0; HotkeyIndex < Hotkeys->size(); ++HotkeyIndex)
     {
-        if(HotkeysAreEqual(&KwmHotkeys[HotkeyIndex], &TempHotkey))
+        if(HotkeysAreEqual(&(*Hotkeys)[HotkeyIndex], &TempHotkey))
         {
             if(Hotkey)
-                *Hotkey = KwmHotkeys[HotkeyIndex];
+                *Hotkey = (*Hotkeys)[HotkeyIndex];
 
             return true;
         }
@@ -170,7 +173,7 @@ void KwmAddHotkey(std::string KeySym, std::string Command)
 {
     hotkey Hotkey = {};
     if(KwmParseHotkey(KeySym, Command, &Hotkey) &&
-       !HotkeyExists(Hotkey.Mod, Hotkey.Key, NULL))
+       !HotkeyExists(&KwmHotkeys, Hotkey.Mod, Hotkey.Key, NULL))
             KwmHotkeys.push_back(Hotkey);
 }
 
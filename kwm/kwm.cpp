@@ -11,25 +11,35 @@ kwm_toggles KWMToggles = {};
 kwm_prefix KWMPrefix = {};
 kwm_focus KWMFocus = {};
 std::vector<hotkey> KwmHotkeys;
+kwm_tap KWMTap = {};
+kwm_monitor KWMMonitor = { KwmRunQueuedCommands, HandleWindowEvents, UpdateWindowsOfMonitor, HasActiveSpaceChanged, 1000, 200, 200, 200, 250 };
+extern kwm_input KWMInput;
+extern kwm_ax KWMAX;
+extern kwm_histogram KWMStats[];
 
 std::map<unsigned int, screen_info> DisplayMap;
 std::vector<window_info> WindowLst;
-std::vector<int> FloatingWindowLst;
-std::vector<std::string> FloatingAppLst;
-std::map<std::string, int> CapturedAppLst;
-std::map<std::string, std::vector<CFTypeRef> > AllowedWindowRoles;
+std::unordered_set<int> FloatingWindowLst;
+std::unordered_map<int, app_rule> AppRules;
+std::map<std::string, layout_template> LayoutCache;
 
 space_tiling_option KwmSpaceMode;
 focus_option KwmFocusMode;
 cycle_focus_option KwmCycleMode;
 
 pthread_t BackgroundThread;
+pthread_t InputThread;
 pthread_t DaemonThread;
 pthread_mutex_t BackgroundLock;
 
+// The event tap never takes BackgroundLock. Everything it needs to decide on
+// an event is read from the last published tap_state, and work that changes
+// state is deferred to the input monitor.
 CGEventRef CGEventCallback(CGEventTapProxy Proxy, CGEventType Type, CGEventRef Event, void *Refcon)
 {
-    pthread_mutex_lock(&BackgroundLock);
+    kwm_time_point Start = std::chrono::steady_clock::now();
+    std::shared_ptr<const tap_state> State = std::atomic_load(&KWMTap.State);
+    CGEventRef Result = Event;
 
     switch(Type)
     {
@@ -41,58 +51,153 @@ CGEventRef CGEventCallback(CGEventTapProxy Proxy, CGEventType Type, CGEventRef E
         } break;
         case kCGEventKeyDown:
         {
-            if(KWMToggles.UseBuiltinHotkeys && KwmMainHotkeyTrigger(&Event))
+            if(State->UseBuiltinHotkeys && KwmMainHotkeyTrigger(State.get(), &Event))
             {
-                    pthread_mutex_unlock(&BackgroundLock);
-                    return NULL;
+                Result = NULL;
+                break;
             }
 
-            if(KwmFocusMode == FocusModeAutofocus)
+            if(State->FocusMode == FocusModeAutofocus)
             {
+                ProcessSerialNumber PSN = State->PSN;
                 CGEventSetIntegerValueField(Event, kCGKeyboardEventAutorepeat, 0);
-                CGEventPostToPSN(&KWMFocus.PSN, Event);
-                pthread_mutex_unlock(&BackgroundLock);
-                return NULL;
+                CGEventPostToPSN(&PSN, Event);
+                Result = NULL;
             }
         } break;
         case kCGEventKeyUp:
         {
-            if(KwmFocusMode == FocusModeAutofocus)
+            if(State->FocusMode == FocusModeAutofocus)
             {
+                ProcessSerialNumber PSN = State->PSN;
                 CGEventSetIntegerValueField(Event, kCGKeyboardEventAutorepeat, 0);
-                CGEventPostToPSN(&KWMFocus.PSN, Event);
-                pthread_mutex_unlock(&BackgroundLock);
-                return NULL;
+                CGEventPostToPSN(&PSN, Event);
+                Result = NULL;
             }
         } break;
         case kCGEventMouseMoved:
         {
-            if(KwmFocusMode != FocusModeDisabled)
-                FocusWindowBelowCursor();
+            if(State->FocusMode != FocusModeDisabled)
+                PushMouseMove(CGEventGetLocation(Event));
         } break;
         case kCGEventLeftMouseDown:
         {
             DEBUG("Left mouse button was pressed")
-            FocusWindowBelowCursor();
-            if(KWMToggles.EnableDragAndDrop && IsCursorInsideFocusedWindow())
-               KWMToggles.WindowDragInProgress = true;
+            PushTapAction(TapActionFocus, "");
+            if(State->EnableDragAndDrop)
+                KWMTap.DragInProgress = GetTapContainerAtPoint(State.get(), CGEventGetLocation(Event), &KWMTap.DragContainer);
         } break;
         case kCGEventLeftMouseUp:
         {
-            if(KWMToggles.EnableDragAndDrop && KWMToggles.WindowDragInProgress)
+            if(State->EnableDragAndDrop && KWMTap.DragInProgress)
             {
-                if(!IsCursorInsideFocusedWindow())
-                    ToggleFocusedWindowFloating();
+                if(!CGRectContainsPoint(KWMTap.DragContainer, CGEventGetLocation(Event)))
+                    PushTapAction(TapActionFloat, "");
 
-                KWMToggles.WindowDragInProgress = false;
+                KWMTap.DragInProgress = false;
             }
 
             DEBUG("Left mouse button was released")
         } break;
     }
 
-    pthread_mutex_unlock(&BackgroundLock);
-    return Event;
+    RecordLatency(StatTapCallback, Start);
+    return Result;
+}
+
+// The click focuses the window below the cursor before the drag is checked,
+// so the container to compare against is that of the window being clicked,
+// or of the focused window if the cursor is not above any window.
+bool GetTapContainerAtPoint(const tap_state *State, CGPoint Cursor, CGRect *Container)
+{
+    const tap_window *Window = NULL;
+    for(std::size_t WindowIndex = 0; WindowIndex < State->Windows.size(); ++WindowIndex)
+    {
+        const tap_window *Candidate = &State->Windows[WindowIndex];
+        if(Cursor.x >= Candidate->Frame.origin.x &&
+           Cursor.x <= Candidate->Frame.origin.x + Candidate->Frame.size.width &&
+           Cursor.y >= Candidate->Frame.origin.y &&
+           Cursor.y <= Candidate->Frame.origin.y + Candidate->Frame.size.height)
+        {
+            Window = Candidate;
+            break;
+        }
+
+        if(!Window && Candidate->WID == State->FocusedWID)
+            Window = Candidate;
+    }
+
+    if(!Window || !Window->Tiled)
+        return false;
+
+    *Container = Window->Container;
+    return Cursor.x >= Container->origin.x &&
+           Cursor.x <= Container->origin.x + Container->size.width &&
+           Cursor.y >= Container->origin.y &&
+           Cursor.y <= Container->origin.y + Container->size.height;
+}
+
+// Called with BackgroundLock held whenever something the event tap reads may
+// have changed. The tap keeps using the snapshot it loaded until its callback
+// returns, so a snapshot is never modified after it has been published.
+void PublishTapState()
+{
+    std::shared_ptr<tap_state> State = std::make_shared<tap_state>();
+    State->Version = ++KWMTap.Version;
+
+    State->Hotkeys = KwmHotkeys;
+    State->PrefixKey = KWMPrefix.Key;
+    State->PrefixEnabled = KWMPrefix.Enabled;
+    State->PrefixTimeout = KWMPrefix.Timeout;
+
+    State->UseBuiltinHotkeys = KWMToggles.UseBuiltinHotkeys;
+    State->EnableDragAndDrop = KWMToggles.EnableDragAndDrop;
+    State->FocusMode = KwmFocusMode;
+
+    State->PSN = KWMFocus.PSN;
+    State->FocusedWID = KWMFocus.Window ? KWMFocus.Window->WID : -1;
+
+    space_info *Space = NULL;
+    if(KWMScreen.Current && DoesSpaceExistInMapOfScreen(KWMScreen.Current))
+        Space = &KWMScreen.Current->Space[KWMScreen.Current->ActiveSpace];
+
+    State->Windows.resize(WindowLst.size());
+    for(std::size_t WindowIndex = 0; WindowIndex < WindowLst.size(); ++WindowIndex)
+    {
+        window_info *Window = &WindowLst[WindowIndex];
+        tap_window *TapWindow = &State->Windows[WindowIndex];
+        TapWindow->WID = Window->WID;
+        TapWindow->Frame = CGRectMake(Window->X, Window->Y, Window->Width, Window->Height);
+
+        tree_node *Node = Space ? GetNodeFromWindowID(Space, Window->WID) : NULL;
+        TapWindow->Tiled = Node != NULL;
+        if(Node)
+            TapWindow->Container = CGRectMake(Node->Container.X, Node->Container.Y,
+                                              Node->Container.Width, Node->Container.Height);
+    }
+
+    std::atomic_store(&KWMTap.State, std::shared_ptr<const tap_state>(State));
+}
+
+void RunTapAction(tap_action *Action)
+{
+    if(Action->Type == TapActionFocus)
+        FocusWindowBelowCursor();
+    else if(Action->Type == TapActionFloat)
+        ToggleFocusedWindowFloating();
+}
+
+std::string GetTapLatencyHistogram()
+{
+    kwm_histogram *Histogram = &KWMStats[StatTapCallback];
+    unsigned long long Count = Histogram->Count.load(std::memory_order_relaxed);
+
+    return "events " + std::to_string(Count) +
+           ", p50 " + FormatLatency(GetHistogramPercentile(Histogram, Count, 0.50)) +
+           ", p99 " + FormatLatency(GetHistogramPercentile(Histogram, Count, 0.99)) +
+           ", max " + FormatLatency(Histogram->Max.load(std::memory_order_relaxed)) +
+           ", coalesced mouse-moves " + std::to_string(KWMInput.Coalesced) +
+           ", state version " + std::to_string(KWMTap.Version);
 }
 
 bool KwmRunLiveCodeHotkeySystem(CGEventRef *Event, modifiers *Mod, CGKeyCode Keycode)
@@ -185,14 +290,85 @@ void KwmQuit()
     exit(0);
 }
 
+KWM_MONITOR_STEP(UpdateWindowsOfMonitor)
+{
+    UpdateWindowTree();
+    ObserveApplicationsInWindowList();
+    return KWMScreen.UpdateSpace;
+}
+
+// Switching spaces or moving the cursor to another display is not reported
+// by any window source, so the monitor checks for both between updates. This
+// is the same check that the window tree update starts with, without reading
+// the window list.
+KWM_MONITOR_STEP(HasActiveSpaceChanged)
+{
+    return IsSpaceTransitionInProgress() ||
+           GetDisplayOfMousePointer() != KWMScreen.Current;
+}
+
+// Window sources wake the monitor as soon as something changes, and
+// RunWindowMonitor decides whether the window tree has to be updated. Queued
+// commands also wake the monitor, and run before the tree is updated.
 void * KwmWindowMonitor(void*)
 {
+    std::vector<window_event> Events;
+    int Timeout = KWMMonitor.PollTimeout;
+
+    KWMMonitor.LastUpdate = KWMMonitor.LastProbe = std::chrono::steady_clock::now();
     while(1)
     {
+        WaitForWindowEvents(&Events, Timeout);
+
         pthread_mutex_lock(&BackgroundLock);
-        UpdateWindowTree();
+        Timeout = RunWindowMonitor(&Events, std::chrono::steady_clock::now());
+
+        if(ReleaseAXQuarantine())
+            ApplyDeferredNodeContainers();
+
+        PublishTapState();
         pthread_mutex_unlock(&BackgroundLock);
-        usleep(200000);
+    }
+}
+
+// Runs what the event tap defers: actions that change state, and
+// focus-follows-mouse. A burst of mouse-moves is reduced to the last cursor
+// position, and the monitor wakes up again on its own once a hovered window
+// has waited out its dwell time. System commands run without BackgroundLock,
+// as they may call back into kwm through kwmc.
+void * KwmInputMonitor(void*)
+{
+    std::vector<tap_action> Actions;
+    CGPoint Cursor = {};
+    int Timeout = -1;
+
+    while(1)
+    {
+        bool Moved = WaitForInput(&Cursor, &Actions, Timeout);
+
+        for(std::size_t ActionIndex = 0; ActionIndex < Actions.size(); ++ActionIndex)
+        {
+            if(Actions[ActionIndex].Type == TapActionSystemCommand)
+            {
+                system(Actions[ActionIndex].Command.c_str());
+                continue;
+            }
+
+            pthread_mutex_lock(&BackgroundLock);
+            RunTapAction(&Actions[ActionIndex]);
+            PublishTapState();
+            pthread_mutex_unlock(&BackgroundLock);
+        }
+
+        if(Moved || Timeout >= 0)
+        {
+            pthread_mutex_lock(&BackgroundLock);
+            int FocusedWID = KWMFocus.Window ? KWMFocus.Window->WID : -1;
+            Timeout = KwmFocusMode != FocusModeDisabled ? HoverWindowAtPoint(Cursor) : -1;
+            if(FocusedWID != (KWMFocus.Window ? KWMFocus.Window->WID : -1))
+                PublishTapState();
+            pthread_mutex_unlock(&BackgroundLock);
+        }
     }
 }
 
@@ -217,17 +393,7 @@ void KwmReloadConfig()
 
 void KwmClearSettings()
 {
-    std::map<std::string, std::vector<CFTypeRef> >::iterator It;
-    for(It = AllowedWindowRoles.begin(); It != AllowedWindowRoles.end(); ++It)
-    {
-        std::vector<CFTypeRef> &WindowRoles = It->second;
-        for(std::size_t RoleIndex = 0; RoleIndex < WindowRoles.size(); ++RoleIndex)
-            CFRelease(WindowRoles[RoleIndex]);
-
-        WindowRoles.clear();
-    }
-
-    FloatingAppLst.clear();
+    ClearApplicationRules();
     KwmHotkeys.clear();
     KWMPrefix.Enabled = false;
 }
@@ -257,7 +423,7 @@ void KwmExecuteConfig()
         if(!Line.empty() && Line[0] != '#')
         {
             if(IsPrefixOfString(Line, "kwmc"))
-                KwmInterpretCommand(Line, 0);
+                KwmInterpretCommand(Line, NULL);
             else if(IsPrefixOfString(Line, "sys"))
                     system(Line.c_str());
         }
@@ -354,6 +520,16 @@ void KwmInit()
     if (pthread_mutex_init(&BackgroundLock, NULL) != 0)
         Fatal("Could not create mutex!");
 
+    if (pthread_mutex_init(&KWMAX.Lock, NULL) != 0)
+        Fatal("Could not create mutex!");
+
+    KWMAX.Quarantine = 5.0;
+    KwmSetAXTimeout(1.0);
+
+    KwmStartWindowEvents();
+    if(!KwmStartDispatchPool())
+        Fatal("Could not create dispatch pool!");
+
     if(KwmStartDaemon())
         pthread_create(&DaemonThread, NULL, &KwmDaemonHandleConnectionBG, NULL);
     else
@@ -374,7 +550,6 @@ void KwmInit()
     KWMToggles.EnableDragAndDrop = true;
     KWMToggles.UseContextMenuFix = true;
     KWMToggles.UseMouseFollowsFocus = true;
-    KWMToggles.WindowDragInProgress = false;
 
     KwmSpaceMode = SpaceModeBSP;
     KwmFocusMode = FocusModeAutoraise;
@@ -391,7 +566,12 @@ void KwmInit()
     KwmExecuteConfig();
     GetActiveDisplays();
 
+    pthread_mutex_lock(&BackgroundLock);
+    PublishTapState();
+    pthread_mutex_unlock(&BackgroundLock);
+
     pthread_create(&BackgroundThread, NULL, &KwmWindowMonitor, NULL);
+    pthread_create(&InputThread, NULL, &KwmInputMonitor, NULL);
 }
 
 bool CheckPrivileges()
@@ -435,6 +615,8 @@ void Fatal(const std::string &Err)
     exit(1);
 }
 
+// The benchmarks link every source of Kwm and bring their own main.
+#ifndef KWM_NO_MAIN
 int main(int argc, char **argv)
 {
     if(CheckArguments(argc, argv))
@@ -464,3 +646,4 @@ int main(int argc, char **argv)
 
     return 0;
 }
+#endif
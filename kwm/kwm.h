@@ -2,24 +2,39 @@
 #define KWM_H
 
 #include <Carbon/Carbon.h>
+#include "backend.h"
+#include "ingest.h"
+#include "monitor.h"
 
 #include <iostream>
 #include <vector>
 #include <map>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
 #include <fstream>
 #include <sstream>
 #include <string>
 #include <chrono>
+#include <memory>
+#include <atomic>
+#include <future>
 
 #include <stdlib.h>
+#include <limits.h>
 #include <string.h>
 #include <unistd.h>
+#include <errno.h>
 #include <libproc.h>
 
 #include <pthread.h>
 #include <dlfcn.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <dirent.h>
 #include <sys/types.h>
+#include <sys/time.h>
 #include <time.h>
 
 #include <sys/socket.h>
@@ -30,14 +45,33 @@ struct hotkey;
 struct modifiers;
 struct container_offset;
 
-struct window_info;
-struct window_role;
 struct screen_info;
 struct space_info;
 struct node_container;
+struct node_pool;
+struct layout_header;
+struct layout_node;
+struct layout_map;
+struct layout_template;
 struct tree_node;
 
 struct kwm_code;
+struct ax_app_stats;
+struct kwm_ax;
+struct kwm_classifier;
+struct app_rule;
+struct window_ref_cache;
+struct window_buffers;
+struct window_grid;
+struct kwm_events;
+struct kwm_command;
+struct kwm_commands;
+struct kwm_input;
+struct kwm_tap;
+struct tap_state;
+struct tap_window;
+struct tap_action;
+struct kwm_histogram;
 struct kwm_prefix;
 struct kwm_toggles;
 struct kwm_path;
@@ -50,8 +84,6 @@ struct kwm_screen;
     #define DEBUG(x) do {} while (0);
 #endif
 
-typedef std::chrono::time_point<std::chrono::steady_clock> kwm_time_point;
-
 #define KWM_HOTKEY_COMMANDS(name) bool name(modifiers Mod, CGKeyCode Keycode)
 typedef KWM_HOTKEY_COMMANDS(kwm_hotkey_commands);
 
@@ -91,6 +123,34 @@ enum space_tiling_option
     SpaceModeFloating
 };
 
+enum tap_action_type
+{
+    TapActionSystemCommand,
+    TapActionFocus,
+    TapActionFloat
+};
+
+enum kwm_stat
+{
+    StatTapCallback,
+    StatUpdateEnumerate,
+    StatUpdateFilter,
+    StatUpdateReconcile,
+    StatLayout,
+    StatApply,
+    StatCommandConfig,
+    StatCommandRead,
+    StatCommandWindow,
+    StatCommandScreen,
+    StatCommandSpace,
+    StatCommandTree,
+    StatCommandOther,
+    StatAXCopy,
+    StatAXSet,
+    StatAXPerform,
+    StatCount
+};
+
 struct modifiers
 {
     bool CmdKey;
@@ -130,25 +190,59 @@ struct tree_node
     tree_node *Parent;
     tree_node *LeftChild;
     tree_node *RightChild;
+    tree_node *PrevLeaf;
+    tree_node *NextLeaf;
 
     int SplitMode;
     double SplitRatio;
+
+    node_container Applied;
+    bool Dirty;
 };
 
-struct window_info
+struct node_pool
 {
-    std::string Name;
-    std::string Owner;
-    int PID, WID;
-    int Layer;
-    int X, Y;
-    int Width, Height;
+    std::vector<tree_node*> Blocks;
+    std::size_t BlockIndex;
+    std::size_t NodeIndex;
+    tree_node *FreeList;
+};
+
+#define KwmLayoutMagic "KWML"
+#define KwmLayoutVersion 1
+
+struct layout_header
+{
+    char Magic[4];
+    unsigned int Version;
+    unsigned int NodeCount;
+    unsigned int Reserved;
+};
+
+struct layout_node
+{
+    double SplitRatio;
+    int SplitMode;
+    int Leaf;
+};
+
+struct layout_map
+{
+    void *Base;
+    std::size_t Size;
+};
+
+struct layout_template
+{
+    std::vector<layout_node> Layout;
+    time_t ModifiedTime;
+    off_t Size;
 };
 
-struct window_role
+struct window_delta
 {
-    CFTypeRef Role;
-    CFTypeRef SubRole;
+    std::vector<window_info*> Added;
+    std::vector<int> Removed;
 };
 
 struct space_info
@@ -158,6 +252,9 @@ struct space_info
 
     space_tiling_option Mode;
     tree_node *RootNode;
+    int Rotation;
+    node_pool Pool;
+    std::unordered_map<int, tree_node*> WindowNodes;
 };
 
 struct screen_info
@@ -168,11 +265,17 @@ struct screen_info
     container_offset Offset;
 
     int ActiveSpace;
-    int OldWindowListCount;
+    bool OldWindowListValid;
     bool ForceContainerUpdate;
     std::map<int, space_info> Space;
 };
 
+struct display_bounds
+{
+    screen_info *Screen;
+    double Left, Right;
+};
+
 struct kwm_code
 {
     void *KwmHotkeySO;
@@ -184,6 +287,164 @@ struct kwm_code
     bool IsValid;
 };
 
+struct ax_app_stats
+{
+    unsigned long long Calls;
+    unsigned long long Slow;
+    unsigned long long Skipped;
+    double Total;
+    double Max;
+
+    int Strikes;
+    bool Quarantined;
+    kwm_time_point Until;
+};
+
+#define KWM_AX_STRIKES 3
+struct kwm_ax
+{
+    pthread_mutex_t Lock;
+    double Timeout;
+    double Quarantine;
+    std::map<int, ax_app_stats> Apps;
+};
+
+enum app_rule_flags
+{
+    AppRuleFloating = 1 << 0,
+    AppRuleCaptured = 1 << 1,
+    AppRuleRoles = 1 << 2
+};
+
+struct app_rule
+{
+    unsigned int Flags;
+    int CapturedScreen;
+    std::vector<CFTypeRef> Roles;
+};
+
+struct kwm_classifier
+{
+    std::map<std::pair<int, int>, bool> Tileable;
+
+    unsigned int Hits;
+    unsigned int Misses;
+};
+
+struct window_buffers
+{
+    std::vector<window_info> Back;
+    std::vector<display_bounds> Displays;
+    std::vector<int> WindowIDs;
+
+    unsigned int Allocations;
+};
+
+struct window_grid
+{
+    bool Valid;
+    double MinX, MinY;
+    double CellSize;
+    int Columns, Rows;
+
+    std::vector<int> CellStart;
+    std::vector<int> CellWindows;
+};
+
+struct window_ref_cache
+{
+    std::map<int, std::map<int, AXUIElementRef> > Elements;
+
+    unsigned int Size;
+    unsigned int Hits;
+    unsigned int Misses;
+};
+
+struct kwm_events
+{
+    std::map<int, AXObserverRef> Observers;
+};
+
+struct kwm_command
+{
+    std::string Text;
+    bool Reply;
+    std::promise<std::string> Result;
+    kwm_command *Next;
+};
+
+struct kwm_commands
+{
+    std::atomic<kwm_command *> Head;
+    unsigned long long Batches;
+    unsigned long long Executed;
+};
+
+struct tap_action
+{
+    tap_action_type Type;
+    std::string Command;
+};
+
+struct kwm_input
+{
+    pthread_mutex_t Lock;
+    pthread_cond_t Ready;
+    CGPoint Cursor;
+    bool Pending;
+    unsigned long long Coalesced;
+    std::vector<tap_action> Actions;
+
+    double Dwell;
+    int HoverWID;
+    kwm_time_point HoverTime;
+};
+
+struct tap_window
+{
+    int WID;
+    CGRect Frame;
+    bool Tiled;
+    CGRect Container;
+};
+
+struct tap_state
+{
+    unsigned long long Version;
+
+    std::vector<hotkey> Hotkeys;
+    hotkey PrefixKey;
+    bool PrefixEnabled;
+    double PrefixTimeout;
+
+    bool UseBuiltinHotkeys;
+    bool EnableDragAndDrop;
+    focus_option FocusMode;
+
+    ProcessSerialNumber PSN;
+    int FocusedWID;
+    std::vector<tap_window> Windows;
+};
+
+struct kwm_tap
+{
+    std::shared_ptr<const tap_state> State;
+    unsigned long long Version;
+
+    bool DragInProgress;
+    CGRect DragContainer;
+};
+
+#define KWM_HISTOGRAM_SUB_BITS 4
+#define KWM_HISTOGRAM_RANGE_BITS 40
+#define KWM_HISTOGRAM_BUCKETS ((KWM_HISTOGRAM_RANGE_BITS - KWM_HISTOGRAM_SUB_BITS + 1) << KWM_HISTOGRAM_SUB_BITS)
+struct kwm_histogram
+{
+    std::atomic<unsigned long long> Buckets[KWM_HISTOGRAM_BUCKETS];
+    std::atomic<unsigned long long> Count;
+    std::atomic<unsigned long long> Max;
+};
+
 struct kwm_prefix
 {
     kwm_time_point Time;
@@ -197,7 +458,6 @@ struct kwm_prefix
 struct kwm_toggles
 {
     bool UseMouseFollowsFocus;
-    bool WindowDragInProgress;
     bool EnableTilingMode;
     bool UseBuiltinHotkeys;
     bool EnableDragAndDrop;
@@ -228,6 +488,7 @@ struct kwm_screen
 
     unsigned int OldScreenID;
     bool UpdateSpace;
+    bool DeferApply;
     int MarkedWindow;
     int SplitMode;
     int PrevSpace;
@@ -248,8 +509,14 @@ void SetRootNodeContainer(screen_info *, tree_node *);
 void CreateNodeContainer(screen_info *, tree_node *, int);
 void CreateNodeContainerPair(screen_info *, tree_node *, tree_node *, int);
 void CreateNodeContainers(screen_info *, tree_node *, bool);
+void CreateChildNodeContainers(screen_info *, tree_node *, bool);
 void ResizeNodeContainer(screen_info *, tree_node *);
+void ResizeChildNodeContainer(screen_info *, tree_node *);
 void ApplyNodeContainer(tree_node *, space_tiling_option);
+void QueueNodeContainer(tree_node *, space_tiling_option);
+void MarkNodeContainersDirty(tree_node *, space_tiling_option);
+bool IsNodeContainerApplied(tree_node *);
+bool NodeContainersAreEqual(node_container *, node_container *);
 int GetOptimalSplitMode(tree_node *);
 void ChangeSplitRatio(double);
 void ToggleNodeSplitMode(screen_info *, tree_node *);
@@ -258,31 +525,44 @@ tree_node *CreateTreeFromWindowIDList(screen_info *, std::vector<window_info*> *
 bool CreateBSPTree(tree_node *, screen_info *, std::vector<window_info*> *);
 bool CreateMonocleTree(tree_node *, screen_info *, std::vector<window_info*> *);
 void RotateTree(tree_node *, int);
-void DestroyNodeTree(tree_node *, space_tiling_option);
-tree_node *CreateRootNode();
+void RotateNodeTree(tree_node *, int);
+void DestroyNodeTree(space_info *);
+tree_node *CreateRootNode(screen_info *);
 tree_node *CreateLeafNode(screen_info *, tree_node *, int, int);
 void CreateLeafNodePair(screen_info *, tree_node *, int, int, int);
 
 tree_node *GetNearestNodeToTheLeft(tree_node *, space_tiling_option);
 tree_node *GetNearestNodeToTheRight(tree_node *, space_tiling_option);
-tree_node *GetNodeFromWindowID(tree_node *, int, space_tiling_option);
+tree_node *GetNodeFromWindowID(space_info *, int);
+void SetNodeWindowID(space_info *, tree_node *, int);
+void LinkLeafNodes(tree_node *, tree_node *);
+tree_node *ThreadLeafNodes(tree_node *, tree_node *);
 tree_node *GetFirstLeafNode(tree_node *);
 tree_node *GetLastLeafNode(tree_node *);
 tree_node *GetNearestLeafNeighbour(tree_node *, space_tiling_option);
 tree_node *GetFirstPseudoLeafNode(tree_node *);
-void SwapNodeWindowIDs(tree_node *, tree_node *);
+tree_node *GetInsertionLeafNode(tree_node *);
+void SwapNodeWindowIDs(space_info *, tree_node *, tree_node *);
 void AddWindowToTreeOfUnfocusedMonitor(screen_info *, window_info *);
 bool IsLeafNode(tree_node *);
 bool IsLeftChild(tree_node *);
 bool IsRightChild(tree_node *);
 
+tree_node *AllocateNode(node_pool *);
+void ReleaseNode(node_pool *, tree_node *);
+void ResetNodePool(node_pool *);
+void FreeNodePool(node_pool *);
+
 screen_info CreateDefaultScreenInfo(int, int);
 void UpdateExistingScreenInfo(screen_info *, int, int);
 void DisplayReconfigurationCallBack(CGDirectDisplayID, CGDisplayChangeSummaryFlags, void *);
 void GetActiveDisplays();
 void RefreshActiveDisplays();
+void ApplyDeferredNodeContainers();
 screen_info *GetDisplayOfMousePointer();
 screen_info *GetDisplayOfWindow(window_info *);
+screen_info *GetDisplayOfWindow(std::vector<display_bounds> *, window_info *);
+void GetDisplayBounds(std::vector<display_bounds> *);
 std::vector<window_info*> GetAllWindowsOnDisplay(int);
 std::vector<int> GetAllWindowIDsOnDisplay(int);
 bool DoesSpaceExistInMapOfScreen(screen_info *);
@@ -302,31 +582,44 @@ void SetDefaultGapOfDisplay(const std::string &, int);
 
 void CreateWindowNodeTree(screen_info *, std::vector<window_info*> *);
 void ShouldWindowNodeTreeUpdate(screen_info *);
+void GetWindowListDelta(space_info *, window_delta *);
 
-void ShouldBSPTreeUpdate(screen_info *, space_info *);
+void ShouldBSPTreeUpdate(screen_info *, space_info *, window_delta *);
+tree_node *InsertWindowIntoBSPTree(screen_info *, int);
+tree_node *DetachWindowFromBSPTree(screen_info *, tree_node *, tree_node **);
 void AddWindowToBSPTree(screen_info *, int);
 void AddWindowToBSPTree();
 void RemoveWindowFromBSPTree(screen_info *, int, bool);
 void RemoveWindowFromBSPTree();
 
-void ShouldMonocleTreeUpdate(screen_info *, space_info *);
+void ShouldMonocleTreeUpdate(screen_info *, space_info *, window_delta *);
 void AddWindowToMonocleTree(screen_info *, int);
 void RemoveWindowFromMonocleTree(screen_info *, int, bool);
 
 bool IsWindowBelowCursor(window_info *);
 bool IsAnyWindowBelowCursor();
+void InvalidateWindowGrid();
+void BuildWindowGrid();
+window_info *GetWindowAtPoint(CGPoint);
 bool IsSpaceFloating(int);
 bool IsApplicationFloating(window_info *);
 bool IsApplicationCapturedByScreen(window_info *);
 void CaptureApplication(window_info *);
-bool IsWindowFloating(int, int *);
+bool IsWindowFloating(int);
+app_rule *GetApplicationRule(window_info *);
+app_rule *CreateApplicationRule(const std::string &);
+void FloatApplication(std::string);
+void ClearApplicationRules();
 bool IsWindowOnActiveSpace(int);
 bool IsSpaceTransitionInProgress();
 bool IsSpaceSystemOrFullscreen();
-bool IsContextMenusAndSimilarVisible();
+bool IsContextMenuOrSimilarWindow(window_info *);
 bool WindowsAreEqual(window_info *, window_info *);
 bool IsAppSpecificWindowRole(window_info *, CFTypeRef, CFTypeRef);
 void AllowRoleForApplication(std::string, std::string);
+bool IsWindowTileable(window_info *);
+void ForgetWindowClass(int, int);
+void PruneWindowClassCache();
 
 void UpdateWindowTree();
 void UpdateActiveWindowList(screen_info *);
@@ -336,6 +629,7 @@ void ShiftWindowFocus(int);
 void SwapFocusedWindowWithNearest(int);
 void SwapFocusedWindowWithMarked();
 void FocusWindowBelowCursor();
+int HoverWindowAtPoint(CGPoint);
 bool FocusWindowOfOSX();
 void FloatFocusedSpace();
 void TileFocusedSpace(space_tiling_option);
@@ -344,10 +638,26 @@ void ToggleFocusedWindowFloating();
 void ToggleFocusedWindowFullscreen();
 void ToggleFocusedWindowParentContainer();
 void SetWindowDimensions(AXUIElementRef, window_info *, int, int, int, int);
+int ApplyWindowFrame(AXUIElementRef, window_info *, int, int, int, int);
+void QueueWindowFrame(tree_node *);
+void DispatchWindowFrames();
+bool BeginAXCall(AXUIElementRef, int *);
+AXError EndAXCall(int, kwm_stat, kwm_time_point, AXError);
+AXError CopyAXAttribute(AXUIElementRef, CFStringRef, CFTypeRef *);
+AXError SetAXAttribute(AXUIElementRef, CFStringRef, CFTypeRef);
+AXError PerformAXAction(AXUIElementRef, CFStringRef);
+bool ReleaseAXQuarantine();
+void ForgetAXStats(int);
+void KwmSetAXTimeout(double);
+std::string GetAXLatencyReport();
+KWM_WINDOW_SET_POSITION(AXSetWindowPosition);
+KWM_WINDOW_SET_SIZE(AXSetWindowSize);
 void CenterWindow(screen_info *, window_info *);
 void ModifyContainerSplitRatio(double);
 void ResizeWindowToContainerSize(tree_node *);
 void ResizeWindowToContainerSize();
+void RotateWindowTree(screen_info *, int);
+void ApplyPendingTreeRotation(screen_info *);
 
 bool IsCursorInsideFocusedWindow();
 CGPoint GetCursorPos();
@@ -366,11 +676,14 @@ CGSize GetWindowSize(AXUIElementRef);
 window_info *GetWindowByID(int);
 bool GetWindowRef(window_info *, AXUIElementRef *);
 bool GetWindowRole(window_info *, CFTypeRef *, CFTypeRef *);
-void GetWindowInfo(const void *, const void *, void *);
+bool CFGetWindowNumber(const void *, window_key, int *);
+const char *CFGetWindowString(const void *, window_key);
+bool CFGetWindowBounds(const void *, int *, int *, int *, int *);
 bool GetWindowFocusedByOSX(int *);
-bool IsApplicationInCache(int, std::vector<AXUIElementRef> *);
 bool GetWindowRefFromCache(window_info *, AXUIElementRef *);
 void FreeWindowRefCache(int);
+void GetSortedWindowIDs(std::vector<int> *);
+void PruneWindowRefCache();
 
 kwm_code LoadKwmCode();
 void UnloadKwmCode(kwm_code *);
@@ -383,18 +696,28 @@ void KwmTerminateDaemon();
 
 void SaveBSPTreeToFile(screen_info *, std::string);
 void LoadBSPTreeFromFile(screen_info *, std::string);
-void SerializeParentNode(tree_node *, std::string, std::vector<std::string> &);
-tree_node *DeserializeNodeTree(std::vector<std::string> &);
-unsigned int DeserializeChildNode(tree_node *, std::vector<std::string> &, unsigned int);
-unsigned int DeserializeParentNode(tree_node *, std::vector<std::string> &, unsigned int);
+void ConvertBSPTreeFile(std::string, std::string);
+void SerializeNodeLayout(tree_node *, std::vector<layout_node> &);
+bool IsValidNodeLayout(const layout_node *, unsigned int);
+tree_node *CreateNodeTreeFromLayout(screen_info *, const layout_node *, unsigned int);
+unsigned int CreateNodeFromLayout(screen_info *, tree_node *, const layout_node *, unsigned int);
+void WriteLayoutText(std::ofstream &, std::vector<layout_node> &, unsigned int *, std::string);
+bool ParseLayoutText(std::ifstream &, std::vector<layout_node> &);
+bool WriteLayoutFile(std::string, std::vector<layout_node> &, bool);
+const layout_node *ReadLayoutFile(std::string, std::vector<layout_node> &, unsigned int *, layout_map *);
+void CloseLayoutFile(layout_map *);
+layout_template *GetLayoutTemplate(std::string);
+void PreloadLayoutTemplates();
 void FillDeserializedTree(tree_node *);
-void CreateDeserializedNodeContainer(tree_node *);
 int ConvertStringToInt(std::string);
 double ConvertStringToDouble(std::string);
 
 std::string KwmReadFromSocket(int);
 void KwmWriteToSocket(int, std::string);
-void KwmInterpretCommand(std::string, int);
+void KwmInterpretCommand(std::string, std::string *);
+kwm_stat GetCommandStat(const std::string &);
+void KwmQueueCommand(const std::string &, std::future<std::string> *);
+bool KwmRunQueuedCommands();
 std::vector<std::string> SplitString(std::string, char);
 bool IsPrefixOfString(std::string &, std::string);
 std::string CreateStringFromTokens(std::vector<std::string>, int);
@@ -403,19 +726,33 @@ bool KwmRunLiveCodeHotkeySystem(CGEventRef *, modifiers *, CGKeyCode);
 CFStringRef KeycodeToString(CGKeyCode);
 bool KeycodeForChar(char, CGKeyCode *);
 bool GetLayoutIndependentKeycode(std::string, CGKeyCode *);
-bool KwmMainHotkeyTrigger(CGEventRef *);
-bool KwmIsPrefixKey(hotkey *, modifiers *, CGKeyCode);
+bool KwmMainHotkeyTrigger(const tap_state *, CGEventRef *);
+bool KwmIsPrefixKey(const hotkey *, modifiers *, CGKeyCode);
 bool KwmParseHotkey(std::string, std::string, hotkey *);
-bool HotkeysAreEqual(hotkey *, hotkey *);
-bool KwmExecuteHotkey(modifiers, CGKeyCode);
-bool HotkeyExists(modifiers, CGKeyCode, hotkey *);
+bool HotkeysAreEqual(const hotkey *, const hotkey *);
+bool KwmExecuteHotkey(const tap_state *, modifiers, CGKeyCode);
+bool HotkeyExists(const std::vector<hotkey> *, modifiers, CGKeyCode, hotkey *);
 void KwmAddHotkey(std::string, std::string);
 void KwmRemoveHotkey(std::string);
 
+void PushMouseMove(CGPoint);
+void PushTapAction(tap_action_type, const std::string &);
+bool WaitForInput(CGPoint *, std::vector<tap_action> *, int);
+void AXApplicationCallback(AXObserverRef, AXUIElementRef, CFStringRef, void *);
+OSStatus CarbonApplicationEventHandler(EventHandlerCallRef, EventRef, void *);
+void KwmStartWindowEvents();
+void ObserveApplication(int);
+void ForgetApplication(int);
+void ObserveApplicationsInWindowList();
+void HandleWindowEvents(std::vector<window_event> *);
+bool UpdateWindowsOfMonitor();
+bool HasActiveSpaceChanged();
+
 void KwmInit();
 void KwmQuit();
 void KwmSetGlobalPrefix(std::string);
 void KwmSetGlobalPrefixTimeout(double);
+void KwmSetFocusDwell(double);
 bool GetTagForCurrentSpace(std::string &);
 bool GetKwmFilePath();
 bool IsKwmAlreadyAddedToLaunchd();
@@ -429,5 +766,17 @@ bool CheckArguments(int, char **);
 bool CheckPrivileges();
 void Fatal(const std::string &);
 CGEventRef CGEventCallback(CGEventTapProxy, CGEventType, CGEventRef, void *);
+void PublishTapState();
+bool GetTapContainerAtPoint(const tap_state *, CGPoint, CGRect *);
+void RunTapAction(tap_action *);
+std::string GetTapLatencyHistogram();
+
+void RecordLatency(kwm_stat, kwm_time_point);
+int GetHistogramBucket(unsigned long long);
+unsigned long long GetHistogramBucketLimit(int);
+unsigned long long GetHistogramPercentile(kwm_histogram *, unsigned long long, double);
+std::string FormatLatency(unsigned long long);
+std::string GetStatsReport();
+void ResetStats();
 
 #endif
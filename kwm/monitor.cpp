@@ -0,0 +1,170 @@
+#include "monitor.h"
+
+#include <algorithm>
+
+#include <errno.h>
+#include <sys/time.h>
+
+extern kwm_monitor KWMMonitor;
+
+bool KwmStartWindowMonitor()
+{
+    return pthread_mutex_init(&KWMMonitor.Lock, NULL) == 0 &&
+           pthread_cond_init(&KWMMonitor.Ready, NULL) == 0;
+}
+
+void PushWindowEvent(window_event_type Type, int PID, int WID)
+{
+    window_event Event = { Type, PID, WID };
+
+    pthread_mutex_lock(&KWMMonitor.Lock);
+    KWMMonitor.Queue.push_back(Event);
+    pthread_cond_signal(&KWMMonitor.Ready);
+    pthread_mutex_unlock(&KWMMonitor.Lock);
+}
+
+// Wakes the monitor without an event, so that it runs the commands that
+// were queued for it.
+void WakeWindowMonitor()
+{
+    pthread_mutex_lock(&KWMMonitor.Lock);
+    KWMMonitor.Woken = true;
+    pthread_cond_signal(&KWMMonitor.Ready);
+    pthread_mutex_unlock(&KWMMonitor.Lock);
+}
+
+// Moving or resizing a window makes its application send the same
+// notifications as when the user does it, so the frames that Kwm writes
+// are recorded per application, and the notifications that follow them
+// are not treated as changes.
+void RecordFrameWrite(int PID)
+{
+    pthread_mutex_lock(&KWMMonitor.Lock);
+    KWMMonitor.FrameWrites[PID] = std::chrono::steady_clock::now();
+    pthread_mutex_unlock(&KWMMonitor.Lock);
+}
+
+bool IsEchoOfFrameWrite(int PID, kwm_time_point Now)
+{
+    bool Result = false;
+    pthread_mutex_lock(&KWMMonitor.Lock);
+    std::map<int, kwm_time_point>::iterator It = KWMMonitor.FrameWrites.find(PID);
+    if(It != KWMMonitor.FrameWrites.end())
+    {
+        if(Now - It->second <= std::chrono::milliseconds(KWMMonitor.EchoTimeout))
+            Result = true;
+        else
+            KWMMonitor.FrameWrites.erase(It);
+    }
+
+    pthread_mutex_unlock(&KWMMonitor.Lock);
+    return Result;
+}
+
+void GetEventDeadline(int Milliseconds, struct timespec *Deadline)
+{
+    struct timeval Now;
+    gettimeofday(&Now, NULL);
+
+    long Nanoseconds = (Now.tv_usec + (Milliseconds % 1000) * 1000L) * 1000L;
+    Deadline->tv_sec = Now.tv_sec + Milliseconds / 1000 + Nanoseconds / 1000000000L;
+    Deadline->tv_nsec = Nanoseconds % 1000000000L;
+}
+
+// Blocks until a window source has pushed an event, a command has been queued
+// or the timeout expires, then hands every queued event to the caller at once
+// so that a burst of notifications is handled by a single update of the
+// window tree.
+bool WaitForWindowEvents(std::vector<window_event> *Events, int Milliseconds)
+{
+    struct timespec Deadline;
+    GetEventDeadline(Milliseconds, &Deadline);
+
+    Events->clear();
+    pthread_mutex_lock(&KWMMonitor.Lock);
+    while(KWMMonitor.Queue.empty() && !KWMMonitor.Woken)
+    {
+        if(pthread_cond_timedwait(&KWMMonitor.Ready, &KWMMonitor.Lock, &Deadline) == ETIMEDOUT)
+            break;
+    }
+
+    KWMMonitor.Woken = false;
+    Events->swap(KWMMonitor.Queue);
+    pthread_mutex_unlock(&KWMMonitor.Lock);
+    return !Events->empty();
+}
+
+int GetMillisecondsUntil(kwm_time_point Deadline, kwm_time_point Now)
+{
+    if(Deadline <= Now)
+        return 0;
+
+    return std::chrono::duration_cast<std::chrono::milliseconds>(Deadline - Now).count() + 1;
+}
+
+// Runs one round of the window monitor on the events that woke it, and
+// returns how long it may wait for the next ones. Events that change the
+// set of windows update the tree right away. Moves are only collected:
+// those that echo a frame Kwm wrote are dropped, and the others update the
+// tree once MoveDelay has passed since the first of them, so that dragging
+// a window does not update the tree more often than the old poll did.
+// The events are sorted out before the queued commands run, so that the
+// frames those commands write do not swallow moves that were already queued.
+// Between updates the active space is checked every SpaceTimeout, and the
+// tree is updated every PollTimeout in case a change was not reported.
+int RunWindowMonitor(std::vector<window_event> *Events, kwm_time_point Now)
+{
+    kwm_monitor *Monitor = &KWMMonitor;
+    bool Update = false;
+    for(std::size_t EventIndex = 0; EventIndex < Events->size(); ++EventIndex)
+    {
+        window_event *Event = &(*Events)[EventIndex];
+        if(Event->Type != WindowEventMoved)
+        {
+            Update = true;
+        }
+        else if(IsEchoOfFrameWrite(Event->PID, Now))
+        {
+            ++Monitor->EchoedMoves;
+        }
+        else if(Monitor->MovePending)
+        {
+            ++Monitor->CoalescedMoves;
+        }
+        else
+        {
+            Monitor->MovePending = true;
+            Monitor->MoveDeadline = Now + std::chrono::milliseconds(Monitor->MoveDelay);
+        }
+    }
+
+    Monitor->RunCommands();
+    Monitor->HandleEvents(Events);
+
+    kwm_time_point PollDeadline = Monitor->LastUpdate + std::chrono::milliseconds(Monitor->Transition ? Monitor->TransitionTimeout : Monitor->PollTimeout);
+    if((Monitor->MovePending && Now >= Monitor->MoveDeadline) || Now >= PollDeadline)
+        Update = true;
+
+    if(!Update && Now >= Monitor->LastProbe + std::chrono::milliseconds(Monitor->SpaceTimeout))
+    {
+        Monitor->LastProbe = Now;
+        Update = Monitor->HasSpaceChanged();
+    }
+
+    if(Update)
+    {
+        Monitor->Transition = Monitor->UpdateWindows();
+        Monitor->MovePending = false;
+        Monitor->LastUpdate = Now;
+        Monitor->LastProbe = Now;
+        ++Monitor->Updates;
+        PollDeadline = Now + std::chrono::milliseconds(Monitor->Transition ? Monitor->TransitionTimeout : Monitor->PollTimeout);
+    }
+
+    int Timeout = std::min(GetMillisecondsUntil(PollDeadline, Now),
+                           GetMillisecondsUntil(Monitor->LastProbe + std::chrono::milliseconds(Monitor->SpaceTimeout), Now));
+    if(Monitor->MovePending)
+        Timeout = std::min(Timeout, GetMillisecondsUntil(Monitor->MoveDeadline, Now));
+
+    return Timeout;
+}
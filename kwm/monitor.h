@@ -0,0 +1,88 @@
+#ifndef KWM_MONITOR_H
+#define KWM_MONITOR_H
+
+#include <vector>
+#include <map>
+#include <chrono>
+
+#include <pthread.h>
+#include <time.h>
+
+// Window sources push events onto a queue that the window monitor drains.
+// The queue, and the decision of when the window tree has to be updated,
+// do not depend on Carbon, so that the monitor can be driven by a scripted
+// window source in the tests. Kwm fills in kwm_monitor with the functions
+// that read the window server and update the trees.
+typedef std::chrono::time_point<std::chrono::steady_clock> kwm_time_point;
+
+struct window_event;
+struct kwm_monitor;
+
+enum window_event_type
+{
+    WindowEventCreated,
+    WindowEventDestroyed,
+    WindowEventMoved,
+    WindowEventFocused,
+    ApplicationEventLaunched,
+    ApplicationEventTerminated,
+    DisplayEventChanged
+};
+
+struct window_event
+{
+    window_event_type Type;
+    int PID, WID;
+};
+
+#define KWM_MONITOR_HANDLE_EVENTS(name) void name(std::vector<window_event> *Events)
+typedef KWM_MONITOR_HANDLE_EVENTS(kwm_monitor_handle_events);
+
+#define KWM_MONITOR_STEP(name) bool name()
+typedef KWM_MONITOR_STEP(kwm_monitor_step);
+
+// RunCommands runs the queued commands. UpdateWindows reads the window list
+// and updates the tree, and returns whether a space transition is still
+// being waited out. HasSpaceChanged returns whether the active space or the
+// display below the cursor changed since the last update, which no window
+// source reports.
+struct kwm_monitor
+{
+    kwm_monitor_step *RunCommands;
+    kwm_monitor_handle_events *HandleEvents;
+    kwm_monitor_step *UpdateWindows;
+    kwm_monitor_step *HasSpaceChanged;
+
+    int PollTimeout;
+    int TransitionTimeout;
+    int SpaceTimeout;
+    int MoveDelay;
+    int EchoTimeout;
+
+    pthread_mutex_t Lock;
+    pthread_cond_t Ready;
+    std::vector<window_event> Queue;
+    std::map<int, kwm_time_point> FrameWrites;
+    bool Woken;
+
+    bool Transition;
+    bool MovePending;
+    kwm_time_point LastUpdate;
+    kwm_time_point LastProbe;
+    kwm_time_point MoveDeadline;
+
+    unsigned long long Updates;
+    unsigned long long CoalescedMoves;
+    unsigned long long EchoedMoves;
+};
+
+bool KwmStartWindowMonitor();
+void PushWindowEvent(window_event_type, int, int);
+void WakeWindowMonitor();
+void RecordFrameWrite(int);
+bool IsEchoOfFrameWrite(int, kwm_time_point);
+void GetEventDeadline(int, struct timespec *);
+bool WaitForWindowEvents(std::vector<window_event> *, int);
+int RunWindowMonitor(std::vector<window_event> *, kwm_time_point);
+
+#endif
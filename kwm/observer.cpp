@@ -0,0 +1,198 @@
+#include "kwm.h"
+
+extern std::vector<window_info> WindowLst;
+
+kwm_events KWMEvents = {};
+kwm_input KWMInput = {};
+
+// Only the most recent cursor position is kept. Moves that arrive while the
+// previous one is still waiting for the input monitor replace it.
+void PushMouseMove(CGPoint Cursor)
+{
+    pthread_mutex_lock(&KWMInput.Lock);
+    if(KWMInput.Pending)
+        ++KWMInput.Coalesced;
+
+    KWMInput.Cursor = Cursor;
+    KWMInput.Pending = true;
+    pthread_cond_signal(&KWMInput.Ready);
+    pthread_mutex_unlock(&KWMInput.Lock);
+}
+
+void PushTapAction(tap_action_type Type, const std::string &Command)
+{
+    tap_action Action = { Type, Command };
+
+    pthread_mutex_lock(&KWMInput.Lock);
+    KWMInput.Actions.push_back(Action);
+    pthread_cond_signal(&KWMInput.Ready);
+    pthread_mutex_unlock(&KWMInput.Lock);
+}
+
+// Waits for a mouse-move or an action deferred by the event tap. A negative
+// timeout waits until one of them arrives. Returns true if the cursor moved.
+bool WaitForInput(CGPoint *Cursor, std::vector<tap_action> *Actions, int Milliseconds)
+{
+    struct timespec Deadline;
+    if(Milliseconds >= 0)
+        GetEventDeadline(Milliseconds, &Deadline);
+
+    Actions->clear();
+    pthread_mutex_lock(&KWMInput.Lock);
+    while(!KWMInput.Pending && KWMInput.Actions.empty())
+    {
+        if(Milliseconds < 0)
+            pthread_cond_wait(&KWMInput.Ready, &KWMInput.Lock);
+        else if(pthread_cond_timedwait(&KWMInput.Ready, &KWMInput.Lock, &Deadline) == ETIMEDOUT)
+            break;
+    }
+
+    Actions->swap(KWMInput.Actions);
+    bool Result = KWMInput.Pending;
+    if(Result)
+    {
+        *Cursor = KWMInput.Cursor;
+        KWMInput.Pending = false;
+    }
+
+    pthread_mutex_unlock(&KWMInput.Lock);
+    return Result;
+}
+
+void AXApplicationCallback(AXObserverRef Observer, AXUIElementRef Element, CFStringRef Notification, void *Reference)
+{
+    int PID = (int)(intptr_t)Reference;
+
+    if(CFEqual(Notification, kAXWindowCreatedNotification))
+    {
+        AXObserverAddNotification(Observer, Element, kAXUIElementDestroyedNotification, Reference);
+        PushWindowEvent(WindowEventCreated, PID, -1);
+    }
+    else if(CFEqual(Notification, kAXUIElementDestroyedNotification))
+    {
+        int WID = -1;
+        if(_AXUIElementGetWindow(Element, &WID) != kAXErrorSuccess)
+            WID = -1;
+
+        PushWindowEvent(WindowEventDestroyed, PID, WID);
+    }
+    else if(CFEqual(Notification, kAXWindowMovedNotification) ||
+            CFEqual(Notification, kAXWindowResizedNotification))
+    {
+        PushWindowEvent(WindowEventMoved, PID, -1);
+    }
+    else if(CFEqual(Notification, kAXFocusedWindowChangedNotification))
+    {
+        PushWindowEvent(WindowEventFocused, PID, -1);
+    }
+}
+
+OSStatus CarbonApplicationEventHandler(EventHandlerCallRef HandlerCallRef, EventRef Event, void *Refcon)
+{
+    ProcessSerialNumber PSN;
+    if(GetEventParameter(Event, kEventParamProcessID, typeProcessSerialNumber, NULL, sizeof(PSN), NULL, &PSN) == noErr)
+    {
+        pid_t PID;
+        if(GetProcessPID(&PSN, &PID) == noErr)
+        {
+            if(GetEventKind(Event) == kEventAppLaunched)
+                PushWindowEvent(ApplicationEventLaunched, PID, -1);
+            else if(GetEventKind(Event) == kEventAppTerminated)
+                PushWindowEvent(ApplicationEventTerminated, PID, -1);
+        }
+    }
+
+    return noErr;
+}
+
+void KwmStartWindowEvents()
+{
+    if(!KwmStartWindowMonitor())
+        Fatal("Could not create window event queue!");
+
+    if(pthread_mutex_init(&KWMInput.Lock, NULL) != 0 ||
+       pthread_cond_init(&KWMInput.Ready, NULL) != 0)
+        Fatal("Could not create input queue!");
+
+    KWMInput.HoverWID = -1;
+
+    EventTypeSpec ApplicationEvents[] = { { kEventClassApplication, kEventAppLaunched },
+                                          { kEventClassApplication, kEventAppTerminated } };
+    InstallEventHandler(GetApplicationEventTarget(), NewEventHandlerUPP(CarbonApplicationEventHandler),
+                        sizeof(ApplicationEvents) / sizeof(*ApplicationEvents), ApplicationEvents, NULL, NULL);
+}
+
+void ObserveApplication(int PID)
+{
+    if(KWMEvents.Observers.find(PID) != KWMEvents.Observers.end())
+        return;
+
+    AXObserverRef Observer;
+    if(AXObserverCreate(PID, AXApplicationCallback, &Observer) != kAXErrorSuccess)
+        return;
+
+    void *Reference = (void *)(intptr_t)PID;
+    AXUIElementRef Application = AXUIElementCreateApplication(PID);
+    if(AXObserverAddNotification(Observer, Application, kAXWindowCreatedNotification, Reference) != kAXErrorSuccess)
+    {
+        CFRelease(Application);
+        CFRelease(Observer);
+        return;
+    }
+
+    AXObserverAddNotification(Observer, Application, kAXWindowMovedNotification, Reference);
+    AXObserverAddNotification(Observer, Application, kAXWindowResizedNotification, Reference);
+    AXObserverAddNotification(Observer, Application, kAXFocusedWindowChangedNotification, Reference);
+    CFRelease(Application);
+
+    DEBUG("ObserveApplication() " << PID)
+    CFRunLoopAddSource(CFRunLoopGetMain(), AXObserverGetRunLoopSource(Observer), kCFRunLoopDefaultMode);
+    KWMEvents.Observers[PID] = Observer;
+}
+
+void ForgetApplication(int PID)
+{
+    std::map<int, AXObserverRef>::iterator It = KWMEvents.Observers.find(PID);
+    if(It != KWMEvents.Observers.end())
+    {
+        DEBUG("ForgetApplication() " << PID)
+        CFRunLoopRemoveSource(CFRunLoopGetMain(), AXObserverGetRunLoopSource(It->second), kCFRunLoopDefaultMode);
+        CFRelease(It->second);
+        KWMEvents.Observers.erase(It);
+    }
+}
+
+// Windows of applications that were running before Kwm started, or that
+// could not be observed when they launched, are picked up from the window
+// list by the reconciliation pass.
+void ObserveApplicationsInWindowList()
+{
+    for(std::size_t WindowIndex = 0; WindowIndex < WindowLst.size(); ++WindowIndex)
+    {
+        if(WindowLst[WindowIndex].Layer == 0)
+            ObserveApplication(WindowLst[WindowIndex].PID);
+    }
+}
+
+void HandleWindowEvents(std::vector<window_event> *Events)
+{
+    for(std::size_t EventIndex = 0; EventIndex < Events->size(); ++EventIndex)
+    {
+        window_event *Event = &(*Events)[EventIndex];
+        if(Event->Type == ApplicationEventLaunched)
+        {
+            ObserveApplication(Event->PID);
+        }
+        else if(Event->Type == WindowEventDestroyed && Event->WID != -1)
+        {
+            ForgetWindowClass(Event->PID, Event->WID);
+        }
+        else if(Event->Type == ApplicationEventTerminated)
+        {
+            ForgetApplication(Event->PID);
+            ForgetWindowClass(Event->PID, -1);
+            FreeWindowRefCache(Event->PID);
+            ForgetAXStats(Event->PID);
+        }
+    }
+}
@@ -0,0 +1,133 @@
+#include "kwm.h"
+
+// The update-* stats only cover the phases of UpdateWindowTree. Layout and
+// apply are recorded for every caller, tree updates and commands alike.
+kwm_histogram KWMStats[StatCount];
+const char *KwmStatNames[StatCount] =
+{
+    "tap-callback",
+    "update-enumerate",
+    "update-filter",
+    "update-reconcile",
+    "layout",
+    "apply",
+    "command-config",
+    "command-read",
+    "command-window",
+    "command-screen",
+    "command-space",
+    "command-tree",
+    "command-other",
+    "ax-copy",
+    "ax-set",
+    "ax-perform"
+};
+
+// Called on the hot paths, from any thread. Recording is a clock read and
+// a few relaxed atomic adds, so no lock is taken and readers may see a
+// count that is slightly ahead of the buckets.
+void RecordLatency(kwm_stat Stat, kwm_time_point Start)
+{
+    unsigned long long Nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - Start).count();
+
+    kwm_histogram *Histogram = &KWMStats[Stat];
+    Histogram->Buckets[GetHistogramBucket(Nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+    Histogram->Count.fetch_add(1, std::memory_order_relaxed);
+
+    unsigned long long Max = Histogram->Max.load(std::memory_order_relaxed);
+    while(Nanoseconds > Max &&
+          !Histogram->Max.compare_exchange_weak(Max, Nanoseconds, std::memory_order_relaxed));
+}
+
+// Values below 2^KWM_HISTOGRAM_SUB_BITS get a bucket each. Above that,
+// every power of two is split into 2^KWM_HISTOGRAM_SUB_BITS linear buckets,
+// which bounds the error of a bucket to 1/16th of its value.
+int GetHistogramBucket(unsigned long long Value)
+{
+    if(Value >= (1ULL << KWM_HISTOGRAM_RANGE_BITS))
+        Value = (1ULL << KWM_HISTOGRAM_RANGE_BITS) - 1;
+
+    if(Value < (1ULL << KWM_HISTOGRAM_SUB_BITS))
+        return (int)Value;
+
+    int Shift = 63 - __builtin_clzll(Value) - KWM_HISTOGRAM_SUB_BITS;
+    int SubBucket = (int)((Value >> Shift) & ((1ULL << KWM_HISTOGRAM_SUB_BITS) - 1));
+    return ((Shift + 1) << KWM_HISTOGRAM_SUB_BITS) + SubBucket;
+}
+
+// Largest value that falls into the bucket.
+unsigned long long GetHistogramBucketLimit(int Bucket)
+{
+    if(Bucket < (1 << KWM_HISTOGRAM_SUB_BITS))
+        return Bucket;
+
+    int Shift = (Bucket >> KWM_HISTOGRAM_SUB_BITS) - 1;
+    unsigned long long SubBucket = Bucket & ((1 << KWM_HISTOGRAM_SUB_BITS) - 1);
+    unsigned long long Lower = ((1ULL << KWM_HISTOGRAM_SUB_BITS) | SubBucket) << Shift;
+    return Lower + (1ULL << Shift) - 1;
+}
+
+unsigned long long GetHistogramPercentile(kwm_histogram *Histogram, unsigned long long Count, double Fraction)
+{
+    unsigned long long Rank = (unsigned long long)(Fraction * Count + 0.5);
+    if(Rank == 0)
+        Rank = 1;
+
+    unsigned long long Max = Histogram->Max.load(std::memory_order_relaxed);
+    unsigned long long Seen = 0;
+    for(int Bucket = 0; Bucket < KWM_HISTOGRAM_BUCKETS; ++Bucket)
+    {
+        Seen += Histogram->Buckets[Bucket].load(std::memory_order_relaxed);
+        if(Seen >= Rank)
+            return std::min(GetHistogramBucketLimit(Bucket), Max);
+    }
+
+    return Max;
+}
+
+std::string FormatLatency(unsigned long long Nanoseconds)
+{
+    if(Nanoseconds < 10000)
+        return std::to_string(Nanoseconds) + "ns";
+    else if(Nanoseconds < 10000000)
+        return std::to_string(Nanoseconds / 1000) + "us";
+    else
+        return std::to_string(Nanoseconds / 1000000) + "ms";
+}
+
+std::string GetStatsReport()
+{
+    std::string Output;
+    for(int Stat = 0; Stat < StatCount; ++Stat)
+    {
+        kwm_histogram *Histogram = &KWMStats[Stat];
+        unsigned long long Count = Histogram->Count.load(std::memory_order_relaxed);
+        if(Count == 0)
+            continue;
+
+        if(!Output.empty())
+            Output += "\n";
+
+        Output += std::string(KwmStatNames[Stat]) +
+                  ": count " + std::to_string(Count) +
+                  ", p50 " + FormatLatency(GetHistogramPercentile(Histogram, Count, 0.50)) +
+                  ", p99 " + FormatLatency(GetHistogramPercentile(Histogram, Count, 0.99)) +
+                  ", max " + FormatLatency(Histogram->Max.load(std::memory_order_relaxed));
+    }
+
+    return Output.empty() ? "no samples" : Output;
+}
+
+// Samples recorded while the histograms are cleared may survive the reset.
+void ResetStats()
+{
+    for(int Stat = 0; Stat < StatCount; ++Stat)
+    {
+        kwm_histogram *Histogram = &KWMStats[Stat];
+        for(int Bucket = 0; Bucket < KWM_HISTOGRAM_BUCKETS; ++Bucket)
+            Histogram->Buckets[Bucket].store(0, std::memory_order_relaxed);
+
+        Histogram->Count.store(0, std::memory_order_relaxed);
+        Histogram->Max.store(0, std::memory_order_relaxed);
+    }
+}
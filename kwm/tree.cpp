@@ -2,6 +2,10 @@
 
 extern kwm_path KWMPath;
 extern kwm_screen KWMScreen;
+extern std::unordered_set<int> FloatingWindowLst;
+extern std::map<std::string, layout_template> LayoutCache;
+
+static const std::size_t NodePoolBlockSize = 64;
 
 node_container LeftVerticalContainerSplit(screen_info *Screen, tree_node *Node)
 {
@@ -98,11 +102,67 @@ void CreateNodeContainerPair(screen_info *Screen, tree_node *LeftNode, tree_node
     }
 }
 
+tree_node *AllocateNode(node_pool *Pool)
+{
+    tree_node *Node = NULL;
+    if(Pool->FreeList)
+    {
+        Node = Pool->FreeList;
+        Pool->FreeList = Node->Parent;
+    }
+    else
+    {
+        if(Pool->NodeIndex == NodePoolBlockSize)
+        {
+            ++Pool->BlockIndex;
+            Pool->NodeIndex = 0;
+        }
+
+        if(Pool->BlockIndex == Pool->Blocks.size())
+            Pool->Blocks.push_back((tree_node*) malloc(sizeof(tree_node) * NodePoolBlockSize));
+
+        Node = &Pool->Blocks[Pool->BlockIndex][Pool->NodeIndex++];
+    }
+
+    std::memset(Node, '\0', sizeof(tree_node));
+    return Node;
+}
+
+void ReleaseNode(node_pool *Pool, tree_node *Node)
+{
+    if(Node)
+    {
+        Node->Parent = Pool->FreeList;
+        Pool->FreeList = Node;
+    }
+}
+
+// Every node of a space lives in the blocks of its pool, so the whole
+// tree can be discarded by rewinding the bump pointer. The blocks are
+// kept around and reused by the next tree created for this space.
+void ResetNodePool(node_pool *Pool)
+{
+    Pool->BlockIndex = 0;
+    Pool->NodeIndex = 0;
+    Pool->FreeList = NULL;
+}
+
+void FreeNodePool(node_pool *Pool)
+{
+    for(std::size_t BlockIndex = 0; BlockIndex < Pool->Blocks.size(); ++BlockIndex)
+        free(Pool->Blocks[BlockIndex]);
+
+    Pool->Blocks.clear();
+    ResetNodePool(Pool);
+}
+
 tree_node *CreateLeafNode(screen_info *Screen, tree_node *Parent, int WindowID, int ContainerType)
 {
-    tree_node *Leaf = (tree_node*) malloc(sizeof(tree_node));
+    space_info *Space = &Screen->Space[Screen->ActiveSpace];
+    tree_node *Leaf = AllocateNode(&Space->Pool);
     Leaf->Parent = Parent;
-    Leaf->WindowID = WindowID;
+    Leaf->WindowID = -1;
+    SetNodeWindowID(Space, Leaf, WindowID);
 
     CreateNodeContainer(Screen, Leaf, ContainerType);
 
@@ -112,10 +172,10 @@ tree_node *CreateLeafNode(screen_info *Screen, tree_node *Parent, int WindowID,
     return Leaf;
 }
 
-tree_node *CreateRootNode()
+tree_node *CreateRootNode(screen_info *Screen)
 {
-    tree_node *RootNode = (tree_node*) malloc(sizeof(tree_node));
-    std::memset(RootNode, '\0', sizeof(tree_node));
+    space_info *Space = &Screen->Space[Screen->ActiveSpace];
+    tree_node *RootNode = AllocateNode(&Space->Pool);
 
     RootNode->WindowID = -1;
     RootNode->Parent = NULL;
@@ -142,7 +202,7 @@ void SetRootNodeContainer(screen_info *Screen, tree_node *Node)
 
 void CreateLeafNodePair(screen_info *Screen, tree_node *Parent, int LeftWindowID, int RightWindowID, int SplitMode)
 {
-    Parent->WindowID = -1;
+    SetNodeWindowID(&Screen->Space[Screen->ActiveSpace], Parent, -1);
     Parent->SplitMode = SplitMode;
     Parent->SplitRatio = KWMScreen.SplitRatio;
 
@@ -156,6 +216,38 @@ void CreateLeafNodePair(screen_info *Screen, tree_node *Parent, int LeftWindowID
         Parent->LeftChild = CreateLeafNode(Screen, Parent, LeftWindowID, 3);
         Parent->RightChild = CreateLeafNode(Screen, Parent, RightWindowID, 4);
     }
+
+    LinkLeafNodes(Parent->PrevLeaf, Parent->LeftChild);
+    LinkLeafNodes(Parent->LeftChild, Parent->RightChild);
+    LinkLeafNodes(Parent->RightChild, Parent->NextLeaf);
+    Parent->PrevLeaf = NULL;
+    Parent->NextLeaf = NULL;
+}
+
+// The leaves of a bsp-tree form an in-order doubly linked list through
+// PrevLeaf and NextLeaf, so that stepping to a neighbouring window does not
+// have to climb the tree. Internal nodes always have both links cleared.
+void LinkLeafNodes(tree_node *Left, tree_node *Right)
+{
+    if(Left)
+        Left->NextLeaf = Right;
+
+    if(Right)
+        Right->PrevLeaf = Left;
+}
+
+tree_node *ThreadLeafNodes(tree_node *Node, tree_node *Prev)
+{
+    if(IsLeafNode(Node))
+    {
+        LinkLeafNodes(Prev, Node);
+        return Node;
+    }
+
+    Node->PrevLeaf = NULL;
+    Node->NextLeaf = NULL;
+    Prev = ThreadLeafNodes(Node->LeftChild, Prev);
+    return ThreadLeafNodes(Node->RightChild, Prev);
 }
 
 bool IsLeafNode(tree_node *Node)
@@ -189,6 +281,19 @@ tree_node *GetLastLeafNode(tree_node *Node)
     return NULL;
 }
 
+tree_node *GetInsertionLeafNode(tree_node *Node)
+{
+    while(!IsLeafNode(Node))
+    {
+        if(!IsLeafNode(Node->LeftChild) && IsLeafNode(Node->RightChild))
+            Node = Node->RightChild;
+        else
+            Node = Node->LeftChild;
+    }
+
+    return Node;
+}
+
 tree_node *GetFirstPseudoLeafNode(tree_node *Node)
 {
     tree_node *Leaf = GetFirstLeafNode(Node);
@@ -225,7 +330,7 @@ tree_node *CreateTreeFromWindowIDList(screen_info *Screen, std::vector<window_in
     if(IsSpaceFloating(Screen->ActiveSpace))
         return NULL;
 
-    tree_node *RootNode = CreateRootNode();
+    tree_node *RootNode = CreateRootNode(Screen);
     SetRootNodeContainer(Screen, RootNode);
 
     bool Result = false;
@@ -238,7 +343,7 @@ tree_node *CreateTreeFromWindowIDList(screen_info *Screen, std::vector<window_in
 
     if(!Result)
     {
-        free(RootNode);
+        ReleaseNode(&Space->Pool, RootNode);
         RootNode = NULL;
     }
 
@@ -247,71 +352,52 @@ tree_node *CreateTreeFromWindowIDList(screen_info *Screen, std::vector<window_in
 
 bool CreateBSPTree(tree_node *RootNode, screen_info *Screen, std::vector<window_info*> *WindowsPtr)
 {
-    bool Result = false;
+    space_info *Space = &Screen->Space[Screen->ActiveSpace];
     std::vector<window_info*> &Windows = *WindowsPtr;
 
-    if(Windows.size() >= 2)
+    std::vector<int> WindowIDs;
+    for(std::size_t WindowIndex = 0; WindowIndex < Windows.size(); ++WindowIndex)
     {
-        tree_node *Root = RootNode;
-        std::size_t FirstIndex;
-        bool FoundValidWindow = false;
-        for(FirstIndex = 0; FirstIndex < Windows.size(); ++FirstIndex)
-        {
-            if(!IsWindowFloating(Windows[FirstIndex]->WID, NULL))
-            {
-                Root->WindowID = Windows[FirstIndex]->WID;
-                FoundValidWindow = true;
-                break;
-            }
-        }
+        if(!IsWindowFloating(Windows[WindowIndex]->WID))
+            WindowIDs.push_back(Windows[WindowIndex]->WID);
+    }
 
-        if(!FoundValidWindow)
-            return false;
+    if(WindowIDs.empty())
+        return false;
 
-        for(std::size_t WindowIndex = FirstIndex + 1; WindowIndex < Windows.size(); ++WindowIndex)
-        {
-            if(!IsWindowFloating(Windows[WindowIndex]->WID, NULL))
-            {
-                while(!IsLeafNode(Root))
-                {
-                    if(!IsLeafNode(Root->LeftChild) && IsLeafNode(Root->RightChild))
-                        Root = Root->RightChild;
-                    else
-                        Root = Root->LeftChild;
-                }
-
-                DEBUG("CreateBSPTree() Create pair of leafs")
-                CreateLeafNodePair(Screen, Root, Root->WindowID, Windows[WindowIndex]->WID, GetOptimalSplitMode(Root));
-                Root = RootNode;
-            }
-        }
+    SetNodeWindowID(Space, RootNode, WindowIDs[0]);
 
-        Result = true;
-    }
-    else if(Windows.size() == 1 && !IsWindowFloating(Windows[0]->WID, NULL))
+    // Splitting a leaf only changes the subtree of its parent, so the descent
+    // for the next window can resume there instead of starting over at the
+    // root. The resulting tree is the same as inserting the windows one by one.
+    tree_node *Root = RootNode;
+    for(std::size_t WindowIndex = 1; WindowIndex < WindowIDs.size(); ++WindowIndex)
     {
-        RootNode->WindowID = Windows[0]->WID;
-        Result = true;
+        tree_node *Leaf = GetInsertionLeafNode(Root);
+        DEBUG("CreateBSPTree() Create pair of leafs")
+        CreateLeafNodePair(Screen, Leaf, Leaf->WindowID, WindowIDs[WindowIndex], GetOptimalSplitMode(Leaf));
+        Root = Leaf->Parent ? Leaf->Parent : RootNode;
     }
 
-    return Result;
+    return true;
 }
 
 bool CreateMonocleTree(tree_node *RootNode, screen_info *Screen, std::vector<window_info*> *WindowsPtr)
 {
     bool Result = false;
+    space_info *Space = &Screen->Space[Screen->ActiveSpace];
     std::vector<window_info*> &Windows = *WindowsPtr;
 
     if(!Windows.empty())
     {
         tree_node *Root = RootNode;
-        Root->WindowID = Windows[0]->WID;
+        SetNodeWindowID(Space, Root, Windows[0]->WID);
 
         for(std::size_t WindowIndex = 1; WindowIndex < Windows.size(); ++WindowIndex)
         {
-            tree_node *Next = CreateRootNode();
+            tree_node *Next = CreateRootNode(Screen);
             SetRootNodeContainer(Screen, Next);
-            Next->WindowID = Windows[WindowIndex]->WID;
+            SetNodeWindowID(Space, Next, Windows[WindowIndex]->WID);
 
             Root->RightChild = Next;
             Next->LeftChild = Root;
@@ -338,14 +424,14 @@ void ChangeSplitRatio(double Value)
     }
 }
 
-void SwapNodeWindowIDs(tree_node *A, tree_node *B)
+void SwapNodeWindowIDs(space_info *Space, tree_node *A, tree_node *B)
 {
     if(A && B)
     {
         DEBUG("SwapNodeWindowIDs() " << A->WindowID << " with " << B->WindowID)
         int TempWindowID = A->WindowID;
-        A->WindowID = B->WindowID;
-        B->WindowID = TempWindowID;
+        SetNodeWindowID(Space, A, B->WindowID);
+        SetNodeWindowID(Space, B, TempWindowID);
         ResizeWindowToContainerSize(A);
         ResizeWindowToContainerSize(B);
     }
@@ -366,24 +452,55 @@ tree_node *GetNearestLeafNeighbour(tree_node *Node, space_tiling_option Mode)
     return NULL;
 }
 
-tree_node *GetNodeFromWindowID(tree_node *Node, int WindowID, space_tiling_option Mode)
+tree_node *GetNodeFromWindowID(space_info *Space, int WindowID)
 {
-    if(Node)
+    std::unordered_map<int, tree_node*>::iterator It = Space->WindowNodes.find(WindowID);
+    if(It != Space->WindowNodes.end())
     {
-        tree_node *CurrentNode = GetFirstLeafNode(Node);;
-        while(CurrentNode)
-        {
-            if(CurrentNode->WindowID == WindowID)
-            {
-                DEBUG("GetNodeFromWindowID() " << WindowID)
-                return CurrentNode;
-            }
+        DEBUG("GetNodeFromWindowID() " << WindowID)
+        return It->second;
+    }
 
-            CurrentNode = GetNearestNodeToTheRight(CurrentNode, Mode);
+    return NULL;
+}
+
+// WindowNodes maps the id of every window that is tiled in the space to the
+// leaf that holds it (every node for monocle spaces). Internal nodes borrow
+// the id of a leaf for parent-container and fullscreen toggles, and those are
+// not indexed, so all writes to tree_node::WindowID must go through here.
+// Moving a window in or out of a borrowing node leaves its leaf with a stale
+// applied frame, so the leaf is marked dirty as well.
+void SetNodeWindowID(space_info *Space, tree_node *Node, int WindowID)
+{
+    if(Node->WindowID != -1)
+    {
+        std::unordered_map<int, tree_node*>::iterator It = Space->WindowNodes.find(Node->WindowID);
+        if(It != Space->WindowNodes.end())
+        {
+            if(It->second == Node)
+                Space->WindowNodes.erase(It);
+            else
+                It->second->Dirty = true;
         }
     }
 
-    return NULL;
+    if(Node->WindowID != WindowID)
+        Node->Dirty = true;
+
+    Node->WindowID = WindowID;
+    if(WindowID != -1)
+    {
+        if(Space->Mode == SpaceModeMonocle || IsLeafNode(Node))
+        {
+            Space->WindowNodes[WindowID] = Node;
+        }
+        else
+        {
+            tree_node *Leaf = GetNodeFromWindowID(Space, WindowID);
+            if(Leaf)
+                Leaf->Dirty = true;
+        }
+    }
 }
 
 void ResizeNodeContainer(screen_info *Screen, tree_node *Node)
@@ -391,40 +508,42 @@ void ResizeNodeContainer(screen_info *Screen, tree_node *Node)
     if(Node)
     {
         if(Node->LeftChild)
-        {
-            CreateNodeContainer(Screen, Node->LeftChild, Node->LeftChild->Container.Type);
-            ResizeNodeContainer(Screen, Node->LeftChild);
-        }
+            ResizeChildNodeContainer(Screen, Node->LeftChild);
 
         if(Node->RightChild)
-        {
-            CreateNodeContainer(Screen, Node->RightChild, Node->RightChild->Container.Type);
-            ResizeNodeContainer(Screen, Node->RightChild);
-        }
+            ResizeChildNodeContainer(Screen, Node->RightChild);
     }
 }
 
+// The containers below a node only depend on the container of that node,
+// so there is no need to descend into a child whose container did not move.
+void ResizeChildNodeContainer(screen_info *Screen, tree_node *Node)
+{
+    node_container OldContainer = Node->Container;
+    CreateNodeContainer(Screen, Node, Node->Container.Type);
+
+    if(!NodeContainersAreEqual(&OldContainer, &Node->Container))
+        ResizeNodeContainer(Screen, Node);
+}
+
+bool NodeContainersAreEqual(node_container *A, node_container *B)
+{
+    return A->X == B->X &&
+           A->Y == B->Y &&
+           A->Width == B->Width &&
+           A->Height == B->Height;
+}
+
 tree_node *GetNearestNodeToTheLeft(tree_node *Node, space_tiling_option Mode)
 {
     if(Node)
     {
         if(Mode == SpaceModeBSP)
         {
-            if(Node->Parent)
-            {
-                tree_node *Root = Node->Parent;
-                if(Root->LeftChild == Node)
-                    return GetNearestNodeToTheLeft(Root, Mode);
-
-                if(IsLeafNode(Root->LeftChild))
-                    return Root->LeftChild;
-
-                Root = Root->LeftChild;
-                while(!IsLeafNode(Root->RightChild))
-                    Root = Root->RightChild;
+            if(!IsLeafNode(Node))
+                Node = GetFirstLeafNode(Node);
 
-                return Root->RightChild;
-            }
+            return Node->PrevLeaf;
         }
         else if(Mode == SpaceModeMonocle)
         {
@@ -441,21 +560,10 @@ tree_node *GetNearestNodeToTheRight(tree_node *Node, space_tiling_option Mode)
     {
         if(Mode == SpaceModeBSP)
         {
-            if(Node->Parent)
-            {
-                tree_node *Root = Node->Parent;
-                if(Root->RightChild == Node)
-                    return GetNearestNodeToTheRight(Root, Mode);
-
-                if(IsLeafNode(Root->RightChild))
-                    return Root->RightChild;
+            if(!IsLeafNode(Node))
+                Node = GetLastLeafNode(Node);
 
-                Root = Root->RightChild;
-                while(!IsLeafNode(Root->LeftChild))
-                    Root = Root->LeftChild;
-
-                return Root->LeftChild;
-            }
+            return Node->NextLeaf;
         }
         else if(Mode == SpaceModeMonocle)
         {
@@ -467,14 +575,24 @@ tree_node *GetNearestNodeToTheRight(tree_node *Node, space_tiling_option Mode)
 }
 
 void CreateNodeContainers(screen_info *Screen, tree_node *Node, bool OptimalSplit)
+{
+    if(Node && Node->LeftChild && Node->RightChild)
+    {
+        kwm_time_point Start = std::chrono::steady_clock::now();
+        CreateChildNodeContainers(Screen, Node, OptimalSplit);
+        RecordLatency(StatLayout, Start);
+    }
+}
+
+void CreateChildNodeContainers(screen_info *Screen, tree_node *Node, bool OptimalSplit)
 {
     if(Node && Node->LeftChild && Node->RightChild)
     {
         Node->SplitMode = OptimalSplit ? GetOptimalSplitMode(Node) : Node->SplitMode;
         CreateNodeContainerPair(Screen, Node->LeftChild, Node->RightChild, Node->SplitMode);
 
-        CreateNodeContainers(Screen, Node->LeftChild, OptimalSplit);
-        CreateNodeContainers(Screen, Node->RightChild, OptimalSplit);
+        CreateChildNodeContainers(Screen, Node->LeftChild, OptimalSplit);
+        CreateChildNodeContainers(Screen, Node->RightChild, OptimalSplit);
     }
 }
 
@@ -489,40 +607,79 @@ void ToggleNodeSplitMode(screen_info *Screen, tree_node *Node)
 }
 
 void ApplyNodeContainer(tree_node *Node, space_tiling_option Mode)
+{
+    if(Node && !KWMScreen.DeferApply)
+    {
+        QueueNodeContainer(Node, Mode);
+        DispatchWindowFrames();
+    }
+}
+
+void QueueNodeContainer(tree_node *Node, space_tiling_option Mode)
 {
     if(Node)
     {
-        if(Node->WindowID != -1)
-            ResizeWindowToContainerSize(Node);
+        if(Node->WindowID != -1 && !IsNodeContainerApplied(Node))
+            QueueWindowFrame(Node);
 
         if(Mode == SpaceModeBSP && Node->LeftChild)
-            ApplyNodeContainer(Node->LeftChild, Mode);
+            QueueNodeContainer(Node->LeftChild, Mode);
 
         if(Node->RightChild)
-            ApplyNodeContainer(Node->RightChild, Mode);
+            QueueNodeContainer(Node->RightChild, Mode);
     }
 }
 
-void DestroyNodeTree(tree_node *Node, space_tiling_option Mode)
+void MarkNodeContainersDirty(tree_node *Node, space_tiling_option Mode)
 {
     if(Node)
     {
+        Node->Dirty = true;
+
         if(Mode == SpaceModeBSP && Node->LeftChild)
-            DestroyNodeTree(Node->LeftChild, Mode);
+            MarkNodeContainersDirty(Node->LeftChild, Mode);
 
         if(Node->RightChild)
-            DestroyNodeTree(Node->RightChild, Mode);
-
-        free(Node);
+            MarkNodeContainersDirty(Node->RightChild, Mode);
     }
 }
 
+// Applied holds the frame that was last sent to the window of the node.
+// Windows are positioned in whole points, so only the integer part counts.
+bool IsNodeContainerApplied(tree_node *Node)
+{
+    return !Node->Dirty &&
+           (int)Node->Applied.X == (int)Node->Container.X &&
+           (int)Node->Applied.Y == (int)Node->Container.Y &&
+           (int)Node->Applied.Width == (int)Node->Container.Width &&
+           (int)Node->Applied.Height == (int)Node->Container.Height;
+}
+
+void DestroyNodeTree(space_info *Space)
+{
+    ResetNodePool(&Space->Pool);
+    Space->WindowNodes.clear();
+    Space->RootNode = NULL;
+    Space->Rotation = 0;
+}
+
 void RotateTree(tree_node *Node, int Deg)
 {
     if (Node == NULL || IsLeafNode(Node))
         return;
 
     DEBUG("RotateTree() " << Deg << " degrees")
+    tree_node *Prev = GetFirstLeafNode(Node)->PrevLeaf;
+    tree_node *Next = GetLastLeafNode(Node)->NextLeaf;
+
+    RotateNodeTree(Node, Deg);
+    LinkLeafNodes(ThreadLeafNodes(Node, Prev), Next);
+}
+
+void RotateNodeTree(tree_node *Node, int Deg)
+{
+    if (Node == NULL || IsLeafNode(Node))
+        return;
 
     if((Deg == 90 && Node->SplitMode == 1) ||
        (Deg == 270 && Node->SplitMode == 2) ||
@@ -537,25 +694,13 @@ void RotateTree(tree_node *Node, int Deg)
     if(Deg != 180)
         Node->SplitMode = Node->SplitMode == 2 ? 1 : 2;
 
-    RotateTree(Node->LeftChild, Deg);
-    RotateTree(Node->RightChild, Deg);
-}
-
-void CreateDeserializedNodeContainer(tree_node *Node)
-{
-    int SplitMode = Node->Parent->SplitMode;
-    int ContainerType = 0;
-
-    if(SplitMode == 1)
-        ContainerType = IsLeftChild(Node) ? 1 : 2;
-    else
-        ContainerType = IsLeftChild(Node) ? 3 : 4;
-
-    CreateNodeContainer(KWMScreen.Current, Node, ContainerType);
+    RotateNodeTree(Node->LeftChild, Deg);
+    RotateNodeTree(Node->RightChild, Deg);
 }
 
 void FillDeserializedTree(tree_node *RootNode)
 {
+    space_info *Space = &KWMScreen.Current->Space[KWMScreen.Current->ActiveSpace];
     std::vector<window_info*> Windows = GetAllWindowsOnDisplay(KWMScreen.Current->ID);
     tree_node *Current = GetFirstLeafNode(RootNode);
 
@@ -563,7 +708,7 @@ void FillDeserializedTree(tree_node *RootNode)
     while(Current)
     {
         if(Counter < Windows.size())
-            Current->WindowID = Windows[Counter++]->WID;
+            SetNodeWindowID(Space, Current, Windows[Counter++]->WID);
 
         Current = GetNearestNodeToTheRight(Current, SpaceModeBSP);
         ++Leafs;
@@ -574,17 +719,10 @@ void FillDeserializedTree(tree_node *RootNode)
         tree_node *Root = RootNode;
         for(; Counter < Windows.size(); ++Counter)
         {
-            while(!IsLeafNode(Root))
-            {
-                if(!IsLeafNode(Root->LeftChild) && IsLeafNode(Root->RightChild))
-                    Root = Root->RightChild;
-                else
-                    Root = Root->LeftChild;
-            }
-
+            tree_node *Leaf = GetInsertionLeafNode(Root);
             DEBUG("FillDeserializedTree() Create pair of leafs")
-            CreateLeafNodePair(KWMScreen.Current, Root, Root->WindowID, Windows[Counter]->WID, GetOptimalSplitMode(Root));
-            Root = RootNode;
+            CreateLeafNodePair(KWMScreen.Current, Leaf, Leaf->WindowID, Windows[Counter]->WID, GetOptimalSplitMode(Leaf));
+            Root = Leaf->Parent ? Leaf->Parent : RootNode;
         }
     }
 }
@@ -605,118 +743,210 @@ double ConvertStringToDouble(std::string Double)
     return SplitRatio;
 }
 
-void SerializeParentNode(tree_node *Parent, std::string Role, std::vector<std::string> &Serialized)
+// Layouts are stored as the pre-order sequence of the nodes of a tree. Only
+// internal nodes carry a split-mode and split-ratio, the containers follow
+// from those and the screen that the layout is restored on.
+void SerializeNodeLayout(tree_node *Node, std::vector<layout_node> &Layout)
 {
-    Serialized.push_back("kwmc tree root create " + Role);
-    Serialized.push_back("kwmc tree split-mode " + std::to_string(Parent->SplitMode));
-    Serialized.push_back("kwmc tree split-ratio " + std::to_string(Parent->SplitRatio));
+    layout_node Record = {};
+    Record.Leaf = IsLeafNode(Node);
+    if(!Record.Leaf)
+    {
+        Record.SplitMode = Node->SplitMode;
+        Record.SplitRatio = Node->SplitRatio;
+    }
 
-    if(IsLeafNode(Parent->LeftChild))
+    Layout.push_back(Record);
+    if(!Record.Leaf)
     {
-        Serialized.push_back("kwmc tree child");
-        Serialized.push_back("kwmc tree leaf create left");
+        SerializeNodeLayout(Node->LeftChild, Layout);
+        SerializeNodeLayout(Node->RightChild, Layout);
     }
-    else
+}
+
+bool IsValidNodeLayout(const layout_node *Layout, unsigned int Count)
+{
+    if(Count == 0 || Layout[0].Leaf)
+        return false;
+
+    unsigned int Pending = 1;
+    for(unsigned int Index = 0; Index < Count; ++Index)
     {
-        Serialized.push_back("kwmc tree child");
-        SerializeParentNode(Parent->LeftChild, "left", Serialized);
+        if(Pending == 0)
+            return false;
+
+        --Pending;
+        if(!Layout[Index].Leaf)
+        {
+            if(Layout[Index].SplitMode != 1 && Layout[Index].SplitMode != 2)
+                return false;
+
+            Pending += 2;
+        }
     }
 
-    if(IsLeafNode(Parent->RightChild))
+    return Pending == 0;
+}
+
+tree_node *CreateNodeTreeFromLayout(screen_info *Screen, const layout_node *Layout, unsigned int Count)
+{
+    if(!IsValidNodeLayout(Layout, Count))
+        return NULL;
+
+    DEBUG("CreateNodeTreeFromLayout() " << Count << " nodes")
+    tree_node *RootNode = CreateRootNode(Screen);
+    SetRootNodeContainer(Screen, RootNode);
+    CreateNodeFromLayout(Screen, RootNode, Layout, 0);
+    ThreadLeafNodes(RootNode, NULL);
+    return RootNode;
+}
+
+unsigned int CreateNodeFromLayout(screen_info *Screen, tree_node *Node, const layout_node *Layout, unsigned int Index)
+{
+    const layout_node *Record = &Layout[Index++];
+    if(!Record->Leaf)
     {
-        Serialized.push_back("kwmc tree child");
-        Serialized.push_back("kwmc tree leaf create right");
+        Node->SplitMode = Record->SplitMode;
+        Node->SplitRatio = Record->SplitRatio;
+
+        Node->LeftChild = CreateLeafNode(Screen, Node, -1, Node->SplitMode == 1 ? 1 : 3);
+        Index = CreateNodeFromLayout(Screen, Node->LeftChild, Layout, Index);
+
+        Node->RightChild = CreateLeafNode(Screen, Node, -1, Node->SplitMode == 1 ? 2 : 4);
+        Index = CreateNodeFromLayout(Screen, Node->RightChild, Layout, Index);
     }
-    else
+
+    return Index;
+}
+
+void WriteLayoutText(std::ofstream &OutFD, std::vector<layout_node> &Layout, unsigned int *Index, std::string Role)
+{
+    layout_node *Record = &Layout[(*Index)++];
+    if(Record->Leaf)
     {
-        Serialized.push_back("kwmc tree child");
-        SerializeParentNode(Parent->RightChild, "right", Serialized);
+        OutFD << "kwmc tree leaf create " << Role << std::endl;
+        return;
     }
+
+    OutFD << "kwmc tree root create " << Role << std::endl;
+    OutFD << "kwmc tree split-mode " << std::to_string(Record->SplitMode) << std::endl;
+    OutFD << "kwmc tree split-ratio " << std::to_string(Record->SplitRatio) << std::endl;
+    OutFD << "kwmc tree child" << std::endl;
+    WriteLayoutText(OutFD, Layout, Index, "left");
+    OutFD << "kwmc tree child" << std::endl;
+    WriteLayoutText(OutFD, Layout, Index, "right");
 }
 
-unsigned int DeserializeParentNode(tree_node *Parent, std::vector<std::string> &Serialized, unsigned int Index)
+bool ParseLayoutText(std::ifstream &InFD, std::vector<layout_node> &Layout)
 {
-    unsigned int LineNumber = Index;
-    for(;LineNumber < Serialized.size(); ++LineNumber)
+    std::string Line;
+    int Parent = -1;
+    while(std::getline(InFD, Line))
     {
-        std::string Line = Serialized[LineNumber];
         std::vector<std::string> Tokens = SplitString(Line, ' ');
+        if(Tokens.size() < 4)
+            continue;
 
-        if(Tokens[2] == "split-mode")
+        if(Tokens[2] == "root" || Tokens[2] == "leaf")
         {
-            Parent->SplitMode = ConvertStringToInt(Tokens[3]);
-            DEBUG("Root: SplitMode Found " + Tokens[3])
+            if(Layout.empty() && Line != "kwmc tree root create parent")
+                return false;
+
+            layout_node Record = {};
+            Record.Leaf = Tokens[2] == "leaf";
+            Layout.push_back(Record);
+            Parent = Record.Leaf ? -1 : Layout.size() - 1;
         }
-        else if(Tokens[2] == "split-ratio")
+        else if(Tokens[2] == "split-mode" && Parent != -1)
         {
-            Parent->SplitRatio = ConvertStringToDouble(Tokens[3]);
-            DEBUG("Root: SplitRatio Found " + Tokens[3])
+            Layout[Parent].SplitMode = ConvertStringToInt(Tokens[3]);
         }
-        else if(Tokens[2] == "child")
+        else if(Tokens[2] == "split-ratio" && Parent != -1)
         {
-            DEBUG("Root: Child Found")
-            DEBUG("Parent: " << Parent->SplitMode << "|" << Parent->SplitRatio)
-            LineNumber = DeserializeChildNode(Parent, Serialized, LineNumber+1);
+            Layout[Parent].SplitRatio = ConvertStringToDouble(Tokens[3]);
         }
+    }
 
-        if(Parent->RightChild)
-            return LineNumber;
+    return IsValidNodeLayout(Layout.data(), Layout.size());
+}
+
+bool WriteLayoutFile(std::string File, std::vector<layout_node> &Layout, bool Binary)
+{
+    std::ofstream OutFD(File, Binary ? std::ios::binary : std::ios::out);
+    if(OutFD.fail())
+        return false;
+
+    if(Binary)
+    {
+        layout_header Header = {};
+        std::memcpy(Header.Magic, KwmLayoutMagic, sizeof(Header.Magic));
+        Header.Version = KwmLayoutVersion;
+        Header.NodeCount = Layout.size();
+
+        OutFD.write((const char *) &Header, sizeof(layout_header));
+        OutFD.write((const char *) Layout.data(), sizeof(layout_node) * Layout.size());
+    }
+    else
+    {
+        unsigned int Index = 0;
+        WriteLayoutText(OutFD, Layout, &Index, "parent");
     }
 
-    return LineNumber;
+    OutFD.close();
+    return !OutFD.fail();
 }
 
-unsigned int DeserializeChildNode(tree_node *Parent, std::vector<std::string> &Serialized, unsigned int Index)
+// Binary layouts are mapped and handed to the caller without a copy. Text
+// layouts are parsed into Layout, which then backs the returned records.
+const layout_node *ReadLayoutFile(std::string File, std::vector<layout_node> &Layout, unsigned int *Count, layout_map *Map)
 {
-    unsigned int LineNumber = Index;
-    for(;LineNumber < Serialized.size(); ++LineNumber)
+    Map->Base = NULL;
+    Map->Size = 0;
+
+    int FD = open(File.c_str(), O_RDONLY);
+    if(FD == -1)
+        return NULL;
+
+    struct stat Attr;
+    if(fstat(FD, &Attr) == 0 && Attr.st_size >= (off_t) sizeof(layout_header))
     {
-        std::string Line = Serialized[LineNumber];
-        if(Line == "kwmc tree root create left")
-        {
-            DEBUG("Child: Create root")
-            Parent->LeftChild = CreateLeafNode(KWMScreen.Current, Parent, -1, 1);
-            CreateDeserializedNodeContainer(Parent->LeftChild);
-            LineNumber = DeserializeParentNode(Parent->LeftChild, Serialized, LineNumber+1);
-            return LineNumber;
-        }
-        else if(Line == "kwmc tree root create right")
-        {
-            DEBUG("Child: Create root")
-            Parent->RightChild = CreateLeafNode(KWMScreen.Current, Parent, -1, 2);
-            CreateDeserializedNodeContainer(Parent->RightChild);
-            LineNumber = DeserializeParentNode(Parent->RightChild, Serialized, LineNumber+1);
-            return LineNumber;
-        }
-        else if(Line == "kwmc tree leaf create left")
-        {
-            DEBUG("Child: Create left leaf")
-            Parent->LeftChild = CreateLeafNode(KWMScreen.Current, Parent, -1, 1);
-            CreateDeserializedNodeContainer(Parent->LeftChild);
-            return LineNumber;
-        }
-        else if(Line == "kwmc tree leaf create right")
+        void *Base = mmap(NULL, Attr.st_size, PROT_READ, MAP_PRIVATE, FD, 0);
+        if(Base != MAP_FAILED)
         {
-            DEBUG("Child: Create right leaf")
-            Parent->RightChild = CreateLeafNode(KWMScreen.Current, Parent, -1, 2);
-            CreateDeserializedNodeContainer(Parent->RightChild);
-            return LineNumber;
+            const layout_header *Header = (const layout_header *) Base;
+            if(std::memcmp(Header->Magic, KwmLayoutMagic, sizeof(Header->Magic)) == 0)
+            {
+                close(FD);
+                Map->Base = Base;
+                Map->Size = Attr.st_size;
+                if(Header->Version != KwmLayoutVersion ||
+                   Attr.st_size < (off_t) (sizeof(layout_header) + sizeof(layout_node) * Header->NodeCount))
+                    return NULL;
+
+                *Count = Header->NodeCount;
+                return (const layout_node *) (Header + 1);
+            }
+
+            munmap(Base, Attr.st_size);
         }
     }
 
-    return LineNumber;
+    close(FD);
+    std::ifstream InFD(File);
+    if(InFD.fail() || !ParseLayoutText(InFD, Layout))
+        return NULL;
+
+    *Count = Layout.size();
+    return Layout.data();
 }
 
-tree_node *DeserializeNodeTree(std::vector<std::string> &Serialized)
+void CloseLayoutFile(layout_map *Map)
 {
-    if(Serialized.empty() || Serialized[0] != "kwmc tree root create parent")
-        return NULL;
+    if(Map->Base)
+        munmap(Map->Base, Map->Size);
 
-    DEBUG("Deserialize: Create Master")
-    tree_node *RootNode = CreateRootNode();
-    SetRootNodeContainer(KWMScreen.Current, RootNode);
-    DeserializeParentNode(RootNode, Serialized, 1);
-    return RootNode;
+    Map->Base = NULL;
+    Map->Size = 0;
 }
 
 void SaveBSPTreeToFile(screen_info *Screen, std::string Name)
@@ -727,19 +957,10 @@ void SaveBSPTreeToFile(screen_info *Screen, std::string Name)
         if(Space->Mode != SpaceModeBSP || IsLeafNode(Space->RootNode))
             return;
 
-        std::string TempPath = KWMPath.EnvHome + "/" + KWMPath.ConfigFolder;
-        std::ofstream OutFD(TempPath + "/" + Name);
-        if(OutFD.fail())
-            return;
-
-        tree_node *Root = Space->RootNode;
-        std::vector<std::string> SerializedTree;
-        SerializeParentNode(Root, "parent", SerializedTree);
-
-        for(std::size_t LineNumber = 0; LineNumber < SerializedTree.size(); ++LineNumber)
-            OutFD << SerializedTree[LineNumber] << std::endl;
-
-        OutFD.close();
+        std::vector<layout_node> Layout;
+        SerializeNodeLayout(Space->RootNode, Layout);
+        WriteLayoutFile(KWMPath.EnvHome + "/" + KWMPath.ConfigFolder + "/" + Name, Layout, false);
+        LayoutCache.erase(Name);
     }
 }
 
@@ -751,19 +972,100 @@ void LoadBSPTreeFromFile(screen_info *Screen, std::string Name)
         if(Space->Mode != SpaceModeBSP)
             return;
 
-        std::string TempPath = KWMPath.EnvHome + "/" + KWMPath.ConfigFolder;
-        std::ifstream InFD(TempPath + "/" + Name);
-        if(InFD.fail())
+        layout_template *Template = GetLayoutTemplate(Name);
+        if(!Template)
             return;
 
-        std::string Line;
-        std::vector<std::string> SerializedTree;
-        while(std::getline(InFD, Line))
-            SerializedTree.push_back(Line);
+        DestroyNodeTree(Space);
+        Space->RootNode = CreateNodeTreeFromLayout(Screen, Template->Layout.data(), Template->Layout.size());
 
-        DestroyNodeTree(Space->RootNode, SpaceModeBSP);
-        Space->RootNode = DeserializeNodeTree(SerializedTree);
         FillDeserializedTree(Space->RootNode);
         ApplyNodeContainer(Space->RootNode, SpaceModeBSP);
     }
 }
+
+void ConvertBSPTreeFile(std::string Name, std::string Format)
+{
+    if(Format != "binary" && Format != "text")
+        return;
+
+    std::string File = KWMPath.EnvHome + "/" + KWMPath.ConfigFolder + "/" + Name;
+
+    layout_map Map;
+    unsigned int Count = 0;
+    std::vector<layout_node> Layout;
+    const layout_node *Records = ReadLayoutFile(File, Layout, &Count, &Map);
+    if(Records && IsValidNodeLayout(Records, Count))
+    {
+        std::vector<layout_node> Converted(Records, Records + Count);
+        CloseLayoutFile(&Map);
+
+        DEBUG("ConvertBSPTreeFile() " << Name << " to " << Format)
+        WriteLayoutFile(File, Converted, Format == "binary");
+        LayoutCache.erase(Name);
+    }
+    else
+    {
+        CloseLayoutFile(&Map);
+    }
+}
+
+// Restoring a layout is usually bound to a hotkey, so parsed layouts are kept
+// in memory by name. An entry is reused for as long as the size and
+// modification time of its file are unchanged. Kwm drops the entry itself
+// whenever it writes the file, as the modification time only has a
+// resolution of one second.
+layout_template *GetLayoutTemplate(std::string Name)
+{
+    std::string File = KWMPath.EnvHome + "/" + KWMPath.ConfigFolder + "/" + Name;
+
+    struct stat Attr;
+    if(stat(File.c_str(), &Attr) != 0)
+    {
+        LayoutCache.erase(Name);
+        return NULL;
+    }
+
+    std::map<std::string, layout_template>::iterator It = LayoutCache.find(Name);
+    if(It != LayoutCache.end() &&
+       It->second.ModifiedTime == Attr.st_mtime &&
+       It->second.Size == Attr.st_size)
+        return &It->second;
+
+    layout_map Map;
+    unsigned int Count = 0;
+    std::vector<layout_node> Layout;
+    const layout_node *Records = ReadLayoutFile(File, Layout, &Count, &Map);
+    if(!Records || !IsValidNodeLayout(Records, Count))
+    {
+        CloseLayoutFile(&Map);
+        LayoutCache.erase(Name);
+        return NULL;
+    }
+
+    DEBUG("GetLayoutTemplate() Cache " << Name)
+    layout_template *Template = &LayoutCache[Name];
+    Template->Layout.assign(Records, Records + Count);
+    Template->ModifiedTime = Attr.st_mtime;
+    Template->Size = Attr.st_size;
+    CloseLayoutFile(&Map);
+    return Template;
+}
+
+void PreloadLayoutTemplates()
+{
+    DIR *Folder = opendir((KWMPath.EnvHome + "/" + KWMPath.ConfigFolder).c_str());
+    if(!Folder)
+        return;
+
+    struct dirent *Entry;
+    while((Entry = readdir(Folder)) != NULL)
+    {
+        std::string Name = Entry->d_name;
+        if(Entry->d_type == DT_REG && Name[0] != '.' && Name != KWMPath.ConfigFile)
+            GetLayoutTemplate(Name);
+    }
+
+    closedir(Folder);
+    DEBUG("PreloadLayoutTemplates() " << LayoutCache.size() << " layouts")
+}
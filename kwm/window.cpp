@@ -5,20 +5,24 @@ static CGWindowListOption OsxWindowListOption = kCGWindowListOptionOnScreenOnly
 extern kwm_screen KWMScreen;
 extern kwm_focus KWMFocus;
 extern kwm_toggles KWMToggles;
+extern kwm_input KWMInput;
+extern kwm_dispatch KWMDispatch;
+extern window_owners KWMOwners;
 
 extern std::vector<window_info> WindowLst;
-extern std::vector<std::string> FloatingAppLst;
-extern std::vector<int> FloatingWindowLst;
-extern std::map<std::string, int> CapturedAppLst;
-extern std::map<std::string, std::vector<CFTypeRef> > AllowedWindowRoles;
+extern std::unordered_set<int> FloatingWindowLst;
+extern std::unordered_map<int, app_rule> AppRules;
 
 extern focus_option KwmFocusMode;
 extern space_tiling_option KwmSpaceMode;
 extern cycle_focus_option KwmCycleMode;
 bool IsContextualMenusVisible = false;
 
-std::map<int, window_role> WindowRoleCache;
-std::map<int, std::vector<AXUIElementRef> > WindowRefsCache;
+kwm_classifier KWMClassifier = {};
+window_ref_cache WindowRefsCache = {};
+window_buffers WindowBuffers;
+kwm_window_reader KWMReader = { CFGetWindowNumber, CFGetWindowString, CFGetWindowBounds };
+window_grid WindowGrid = {};
 
 bool GetTagForCurrentSpace(std::string &Tag)
 {
@@ -94,25 +98,63 @@ bool WindowsAreEqual(window_info *Window, window_info *Match)
     return Result;
 }
 
-void AllowRoleForApplication(std::string Application, std::string Role)
+app_rule *GetApplicationRule(window_info *Window)
+{
+    std::unordered_map<int, app_rule>::iterator It = AppRules.find(Window->OwnerID);
+    return It != AppRules.end() ? &It->second : NULL;
+}
+
+app_rule *CreateApplicationRule(const std::string &Application)
+{
+    int OwnerID = GetWindowOwnerID(Application.c_str());
+    std::unordered_map<int, app_rule>::iterator It = AppRules.find(OwnerID);
+    if(It == AppRules.end())
+    {
+        app_rule Rule = { 0, -1 };
+        It = AppRules.insert(std::make_pair(OwnerID, Rule)).first;
+    }
+
+    return &It->second;
+}
+
+void FloatApplication(std::string Application)
 {
-    std::map<std::string, std::vector<CFTypeRef> >::iterator It = AllowedWindowRoles.find(Application);
-    if(It == AllowedWindowRoles.end())
-        AllowedWindowRoles[Application] = std::vector<CFTypeRef>();
+    CreateApplicationRule(Application)->Flags |= AppRuleFloating;
+}
 
+void ClearApplicationRules()
+{
+    std::unordered_map<int, app_rule>::iterator It;
+    for(It = AppRules.begin(); It != AppRules.end(); ++It)
+    {
+        app_rule *Rule = &It->second;
+        for(std::size_t RoleIndex = 0; RoleIndex < Rule->Roles.size(); ++RoleIndex)
+            CFRelease(Rule->Roles[RoleIndex]);
+
+        Rule->Roles.clear();
+        Rule->Flags &= AppRuleCaptured;
+    }
+
+    KWMClassifier.Tileable.clear();
+}
+
+void AllowRoleForApplication(std::string Application, std::string Role)
+{
+    app_rule *Rule = CreateApplicationRule(Application);
     CFStringRef RoleRef = CFStringCreateWithCString(NULL, Role.c_str(), kCFStringEncodingMacRoman);
-    AllowedWindowRoles[Application].push_back(RoleRef);
+    Rule->Roles.push_back(RoleRef);
+    Rule->Flags |= AppRuleRoles;
+    KWMClassifier.Tileable.clear();
 }
 
 bool IsAppSpecificWindowRole(window_info *Window, CFTypeRef Role, CFTypeRef SubRole)
 {
-    std::map<std::string, std::vector<CFTypeRef> >::iterator It = AllowedWindowRoles.find(Window->Owner);
-    if(It != AllowedWindowRoles.end())
+    app_rule *Rule = GetApplicationRule(Window);
+    if(Rule && (Rule->Flags & AppRuleRoles))
     {
-        std::vector<CFTypeRef> &WindowRoles = It->second;
-        for(std::size_t RoleIndex = 0; RoleIndex < WindowRoles.size(); ++RoleIndex)
+        for(std::size_t RoleIndex = 0; RoleIndex < Rule->Roles.size(); ++RoleIndex)
         {
-            if(CFEqual(Role, WindowRoles[RoleIndex]) || CFEqual(SubRole, WindowRoles[RoleIndex]))
+            if(CFEqual(Role, Rule->Roles[RoleIndex]) || CFEqual(SubRole, Rule->Roles[RoleIndex]))
                 return true;
         }
     }
@@ -120,54 +162,129 @@ bool IsAppSpecificWindowRole(window_info *Window, CFTypeRef Role, CFTypeRef SubR
     return false;
 }
 
-bool IsContextMenusAndSimilarVisible()
+bool IsWindowTileable(window_info *Window)
 {
-    bool Result = false;
+    std::pair<int, int> Key(Window->PID, Window->WID);
+    std::map<std::pair<int, int>, bool>::iterator It = KWMClassifier.Tileable.find(Key);
+    if(It != KWMClassifier.Tileable.end())
+    {
+        ++KWMClassifier.Hits;
+        return It->second;
+    }
 
-    for(std::size_t WindowIndex = 0; WindowIndex < WindowLst.size(); ++WindowIndex)
+    ++KWMClassifier.Misses;
+    CFTypeRef Role, SubRole;
+    if(!GetWindowRole(Window, &Role, &SubRole))
+        return false;
+
+    bool Result = false;
+    if(Role && SubRole)
     {
-        if((WindowLst[WindowIndex].Owner != "Dock" ||
-            WindowLst[WindowIndex].Name != "Dock") &&
-            WindowLst[WindowIndex].Layer != 0)
-        {
-            Result = true;
-            break;
-        }
+        Result = (CFEqual(Role, kAXWindowRole) && CFEqual(SubRole, kAXStandardWindowSubrole)) ||
+                 IsAppSpecificWindowRole(Window, Role, SubRole);
+        KWMClassifier.Tileable[Key] = Result;
     }
 
+    if(Role)
+        CFRelease(Role);
+    if(SubRole)
+        CFRelease(SubRole);
+
+    DEBUG("IsWindowTileable() " << Window->Name << ": " << Result << " (" << KWMClassifier.Hits << " hits, " << KWMClassifier.Misses << " misses)")
     return Result;
 }
 
+void ForgetWindowClass(int PID, int WID)
+{
+    if(WID != -1)
+    {
+        KWMClassifier.Tileable.erase(std::make_pair(PID, WID));
+    }
+    else
+    {
+        std::map<std::pair<int, int>, bool>::iterator First = KWMClassifier.Tileable.lower_bound(std::make_pair(PID, INT_MIN));
+        std::map<std::pair<int, int>, bool>::iterator Last = KWMClassifier.Tileable.lower_bound(std::make_pair(PID + 1, INT_MIN));
+        KWMClassifier.Tileable.erase(First, Last);
+    }
+}
+
+// The destroyed notification rarely carries a window id, and is not seen
+// at all for windows that existed before their application was observed,
+// so classifications are also dropped once a window leaves the list.
+void PruneWindowClassCache()
+{
+    std::vector<int> &WindowIDs = WindowBuffers.WindowIDs;
+    GetSortedWindowIDs(&WindowIDs);
+
+    std::map<std::pair<int, int>, bool>::iterator It = KWMClassifier.Tileable.begin();
+    while(It != KWMClassifier.Tileable.end())
+    {
+        if(!std::binary_search(WindowIDs.begin(), WindowIDs.end(), It->first.second))
+            KWMClassifier.Tileable.erase(It++);
+        else
+            ++It;
+    }
+}
+
+bool IsContextMenuOrSimilarWindow(window_info *Window)
+{
+    return (GetWindowOwner(Window) != "Dock" || Window->Name != "Dock") &&
+           Window->Layer != 0;
+}
+
 bool FilterWindowList(screen_info *Screen)
 {
+    kwm_time_point Start = std::chrono::steady_clock::now();
     bool Result = true;
-    std::vector<window_info> FilteredWindowLst;
+    bool MenuVisible = false;
+    std::size_t FilteredCount = 0;
+    std::vector<window_info> &FilteredWindowLst = WindowBuffers.Back;
 
+    GetDisplayBounds(&WindowBuffers.Displays);
     for(std::size_t WindowIndex = 0; WindowIndex < WindowLst.size(); ++WindowIndex)
     {
+        window_info *Window = &WindowLst[WindowIndex];
+
         // Mission-Control mode is on and so we do not try to tile windows
-        if(WindowLst[WindowIndex].Owner == "Dock" &&
-           WindowLst[WindowIndex].Name == "")
-               Result = false;
+        if(GetWindowOwner(Window) == "Dock" && Window->Name == "")
+            Result = false;
 
-        if(KWMToggles.UseContextMenuFix)
-            IsContextualMenusVisible = IsContextMenusAndSimilarVisible();
+        if(!MenuVisible && IsContextMenuOrSimilarWindow(Window))
+            MenuVisible = true;
 
-        CaptureApplication(&WindowLst[WindowIndex]);
-        if(WindowLst[WindowIndex].Layer == 0 &&
-           Screen == GetDisplayOfWindow(&WindowLst[WindowIndex]))
+        CaptureApplication(Window);
+        if(Window->Layer == 0 &&
+           Screen == GetDisplayOfWindow(&WindowBuffers.Displays, Window) &&
+           IsWindowTileable(Window))
         {
-            CFTypeRef Role, SubRole;
-            if(GetWindowRole(&WindowLst[WindowIndex], &Role, &SubRole))
+            if(FilteredCount == FilteredWindowLst.size())
+            {
+                if(FilteredWindowLst.size() == FilteredWindowLst.capacity())
+                    ++WindowBuffers.Allocations;
+
+                FilteredWindowLst.push_back(*Window);
+                if(FilteredWindowLst.back().Name.capacity() > std::string().capacity())
+                    ++WindowBuffers.Allocations;
+            }
+            else
             {
-                if((CFEqual(Role, kAXWindowRole) && CFEqual(SubRole, kAXStandardWindowSubrole)) ||
-                   IsAppSpecificWindowRole(&WindowLst[WindowIndex], Role, SubRole))
-                        FilteredWindowLst.push_back(WindowLst[WindowIndex]);
+                std::size_t Capacity = FilteredWindowLst[FilteredCount].Name.capacity();
+                FilteredWindowLst[FilteredCount] = *Window;
+                if(FilteredWindowLst[FilteredCount].Name.capacity() != Capacity)
+                    ++WindowBuffers.Allocations;
             }
+
+            ++FilteredCount;
         }
     }
 
-    WindowLst = FilteredWindowLst;
+    if(KWMToggles.UseContextMenuFix)
+        IsContextualMenusVisible = MenuVisible;
+
+    FilteredWindowLst.resize(FilteredCount);
+    WindowLst.swap(FilteredWindowLst);
+    InvalidateWindowGrid();
+    RecordLatency(StatUpdateFilter, Start);
     return Result;
 }
 
@@ -178,7 +295,7 @@ bool IsCursorInsideFocusedWindow()
     if(KWMScreen.Current && DoesSpaceExistInMapOfScreen(KWMScreen.Current) && KWMFocus.Window)
     {
         space_info *Space = &KWMScreen.Current->Space[KWMScreen.Current->ActiveSpace];
-        tree_node *Node = GetNodeFromWindowID(Space->RootNode, KWMFocus.Window->WID, Space->Mode);
+        tree_node *Node = GetNodeFromWindowID(Space, KWMFocus.Window->WID);
         if(Node)
         {
             CGPoint Cursor = GetCursorPos();
@@ -209,20 +326,16 @@ bool IsSpaceFloating(int SpaceID)
 
 bool IsApplicationCapturedByScreen(window_info *Window)
 {
-    bool Result = false;
-
-    std::map<std::string, int>::iterator It = CapturedAppLst.find(Window->Owner);
-    if(It != CapturedAppLst.end())
-        Result = true;
-
-    return Result;
+    app_rule *Rule = GetApplicationRule(Window);
+    return Rule && (Rule->Flags & AppRuleCaptured);
 }
 
 void CaptureApplication(window_info *Window)
 {
-    if(IsApplicationCapturedByScreen(Window))
+    app_rule *Rule = GetApplicationRule(Window);
+    if(Rule && (Rule->Flags & AppRuleCaptured))
     {
-        int CapturedID = CapturedAppLst[Window->Owner];
+        int CapturedID = Rule->CapturedScreen;
         screen_info *Screen = GetDisplayFromScreenID(CapturedID);
         if(Screen && Screen != GetDisplayOfWindow(Window))
         {
@@ -235,57 +348,128 @@ void CaptureApplication(window_info *Window)
 
 bool IsApplicationFloating(window_info *Window)
 {
-    bool Result = false;
+    app_rule *Rule = GetApplicationRule(Window);
+    return Rule && (Rule->Flags & AppRuleFloating);
+}
 
-    for(std::size_t WindowIndex = 0; WindowIndex < FloatingAppLst.size(); ++WindowIndex)
-    {
-        if(Window->Owner == FloatingAppLst[WindowIndex])
-        {
-            Result = true;
-            break;
-        }
-    }
+bool IsWindowFloating(int WindowID)
+{
+    return FloatingWindowLst.find(WindowID) != FloatingWindowLst.end();
+}
 
-    return Result;
+bool IsAnyWindowBelowCursor()
+{
+    return GetWindowAtPoint(GetCursorPos()) != NULL;
 }
 
-bool IsWindowFloating(int WindowID, int *Index)
+void InvalidateWindowGrid()
 {
-    bool Result = false;
+    WindowGrid.Valid = false;
+}
+
+// The grid covers the bounding box of WindowLst with square cells, and every
+// cell lists the windows that overlap it in WindowLst order. A hit test only
+// has to check the windows of a single cell, and the first one that contains
+// the point is also the front-most one, the same as a scan of WindowLst.
+void BuildWindowGrid()
+{
+    WindowGrid.Valid = true;
+    WindowGrid.Columns = 0;
+    WindowGrid.Rows = 0;
+    WindowGrid.CellStart.clear();
+    WindowGrid.CellWindows.clear();
+    if(WindowLst.empty())
+        return;
 
-    for(std::size_t WindowIndex = 0; WindowIndex < FloatingWindowLst.size(); ++WindowIndex)
+    double MinX = WindowLst[0].X, MinY = WindowLst[0].Y;
+    double MaxX = MinX, MaxY = MinY;
+    for(std::size_t WindowIndex = 0; WindowIndex < WindowLst.size(); ++WindowIndex)
     {
-        if(WindowID == FloatingWindowLst[WindowIndex])
+        window_info *Window = &WindowLst[WindowIndex];
+        MinX = std::min(MinX, (double)Window->X);
+        MinY = std::min(MinY, (double)Window->Y);
+        MaxX = std::max(MaxX, (double)Window->X + Window->Width);
+        MaxY = std::max(MaxY, (double)Window->Y + Window->Height);
+    }
+
+    double CellSize = std::max(128.0, std::max(MaxX - MinX, MaxY - MinY) / 64);
+    WindowGrid.MinX = MinX;
+    WindowGrid.MinY = MinY;
+    WindowGrid.CellSize = CellSize;
+    WindowGrid.Columns = (MaxX - MinX) / CellSize + 1;
+    WindowGrid.Rows = (MaxY - MinY) / CellSize + 1;
+
+    int Cells = WindowGrid.Columns * WindowGrid.Rows;
+    WindowGrid.CellStart.assign(Cells + 1, 0);
+    for(int Pass = 0; Pass < 2; ++Pass)
+    {
+        for(std::size_t WindowIndex = 0; WindowIndex < WindowLst.size(); ++WindowIndex)
         {
-            DEBUG("IsWindowFloating(): floating " << WindowID)
-            Result = true;
+            window_info *Window = &WindowLst[WindowIndex];
+            int FirstColumn = (Window->X - MinX) / CellSize;
+            int FirstRow = (Window->Y - MinY) / CellSize;
+            int LastColumn = (Window->X + Window->Width - MinX) / CellSize;
+            int LastRow = (Window->Y + Window->Height - MinY) / CellSize;
 
-            if(Index)
-                *Index = WindowIndex;
+            for(int Row = FirstRow; Row <= LastRow; ++Row)
+            {
+                for(int Column = FirstColumn; Column <= LastColumn; ++Column)
+                {
+                    int Cell = Row * WindowGrid.Columns + Column;
+                    if(Pass == 0)
+                        ++WindowGrid.CellStart[Cell + 1];
+                    else
+                        WindowGrid.CellWindows[WindowGrid.CellStart[Cell]++] = WindowIndex;
+                }
+            }
+        }
+
+        if(Pass == 0)
+        {
+            for(int Cell = 0; Cell < Cells; ++Cell)
+                WindowGrid.CellStart[Cell + 1] += WindowGrid.CellStart[Cell];
 
-            break;
+            WindowGrid.CellWindows.resize(WindowGrid.CellStart[Cells]);
         }
-    }
+        else
+        {
+            for(int Cell = Cells; Cell > 0; --Cell)
+                WindowGrid.CellStart[Cell] = WindowGrid.CellStart[Cell - 1];
 
-    return Result;
+            WindowGrid.CellStart[0] = 0;
+        }
+    }
 }
 
-bool IsAnyWindowBelowCursor()
+window_info *GetWindowAtPoint(CGPoint Point)
 {
-    CGPoint Cursor = GetCursorPos();
-    for(std::size_t WindowIndex = 0; WindowIndex < WindowLst.size(); ++WindowIndex)
+    if(!WindowGrid.Valid)
+        BuildWindowGrid();
+
+    if(WindowGrid.Columns == 0 ||
+       Point.x < WindowGrid.MinX ||
+       Point.y < WindowGrid.MinY)
+        return NULL;
+
+    int Column = (Point.x - WindowGrid.MinX) / WindowGrid.CellSize;
+    int Row = (Point.y - WindowGrid.MinY) / WindowGrid.CellSize;
+    if(Column >= WindowGrid.Columns || Row >= WindowGrid.Rows)
+        return NULL;
+
+    int Cell = Row * WindowGrid.Columns + Column;
+    for(int Index = WindowGrid.CellStart[Cell]; Index < WindowGrid.CellStart[Cell + 1]; ++Index)
     {
-        window_info *Window = &WindowLst[WindowIndex];
-        if(Cursor.x >= Window->X &&
-           Cursor.x <= Window->X + Window->Width &&
-           Cursor.y >= Window->Y &&
-           Cursor.y <= Window->Y + Window->Height)
+        window_info *Window = &WindowLst[WindowGrid.CellWindows[Index]];
+        if(Point.x >= Window->X &&
+           Point.x <= Window->X + Window->Width &&
+           Point.y >= Window->Y &&
+           Point.y <= Window->Y + Window->Height)
         {
-            return true;
+            return Window;
         }
     }
 
-    return false;
+    return NULL;
 }
 
 bool IsWindowBelowCursor(window_info *Window)
@@ -399,22 +583,63 @@ void FocusWindowBelowCursor()
        (KWMToggles.UseContextMenuFix && IsContextualMenusVisible))
            return;
 
-    for(std::size_t WindowIndex = 0; WindowIndex < WindowLst.size(); ++WindowIndex)
+    window_info *Window = GetWindowAtPoint(GetCursorPos());
+    if(Window)
     {
-        if(IsWindowBelowCursor(&WindowLst[WindowIndex]))
-        {
-            if(WindowsAreEqual(KWMFocus.Window, &WindowLst[WindowIndex]))
-                KWMFocus.Cache = WindowLst[WindowIndex];
-            else
-                SetWindowFocus(&WindowLst[WindowIndex]);
+        if(WindowsAreEqual(KWMFocus.Window, Window))
+            KWMFocus.Cache = *Window;
+        else
+            SetWindowFocus(Window);
+    }
+}
 
-            break;
-        }
+// Focus only moves once the cursor has stayed above the same window for the
+// configured dwell time. Returns the number of milliseconds left to wait, or
+// -1 when there is no window waiting for focus.
+int HoverWindowAtPoint(CGPoint Cursor)
+{
+    window_info *Window = NULL;
+    if(!IsSpaceTransitionInProgress() &&
+       !IsSpaceSystemOrFullscreen() &&
+       IsSpaceInitializedForScreen(KWMScreen.Current) &&
+       !(KWMToggles.UseContextMenuFix && IsContextualMenusVisible))
+           Window = GetWindowAtPoint(Cursor);
+
+    if(!Window || WindowsAreEqual(KWMFocus.Window, Window))
+    {
+        if(Window)
+            KWMFocus.Cache = *Window;
+
+        KWMInput.HoverWID = -1;
+        return -1;
+    }
+
+    kwm_time_point Now = std::chrono::steady_clock::now();
+    if(KWMInput.HoverWID != Window->WID)
+    {
+        KWMInput.HoverWID = Window->WID;
+        KWMInput.HoverTime = Now;
     }
+
+    double Elapsed = std::chrono::duration<double>(Now - KWMInput.HoverTime).count();
+    if(Elapsed >= KWMInput.Dwell)
+    {
+        SetWindowFocus(Window);
+        KWMInput.HoverWID = -1;
+        return -1;
+    }
+
+    return (int)((KWMInput.Dwell - Elapsed) * 1000.0) + 1;
+}
+
+void KwmSetFocusDwell(double Seconds)
+{
+    KWMInput.Dwell = Seconds > 0 ? Seconds : 0;
 }
 
 void UpdateWindowTree()
 {
+    ApplyPendingTreeRotation(KWMScreen.Current);
     KWMScreen.OldScreenID = KWMScreen.Current->ID;
     KWMScreen.Current = GetDisplayOfMousePointer();
     if(!KWMScreen.Current)
@@ -448,9 +673,7 @@ void UpdateWindowTree()
             }
             else if(It != KWMScreen.Current->Space.end() && WindowsOnDisplay.empty())
             {
-                DestroyNodeTree(KWMScreen.Current->Space[KWMScreen.Current->ActiveSpace].RootNode, 
-                                KWMScreen.Current->Space[KWMScreen.Current->ActiveSpace].Mode);
-                KWMScreen.Current->Space[KWMScreen.Current->ActiveSpace].RootNode = NULL;
+                DestroyNodeTree(&KWMScreen.Current->Space[KWMScreen.Current->ActiveSpace]);
             }
         }
     }
@@ -458,22 +681,44 @@ void UpdateWindowTree()
 
 void UpdateActiveWindowList(screen_info *Screen)
 {
-    Screen->OldWindowListCount = WindowLst.size();
-    WindowLst.clear();
+    Screen->OldWindowListValid = true;
 
+    kwm_time_point Start = std::chrono::steady_clock::now();
     CFArrayRef OsxWindowLst = CGWindowListCopyWindowInfo(OsxWindowListOption, kCGNullWindowID);
     if(!OsxWindowLst)
+    {
+        WindowLst.clear();
+        InvalidateWindowGrid();
+        RecordLatency(StatUpdateEnumerate, Start);
         return;
+    }
 
+    unsigned int Allocations = WindowBuffers.Allocations + KWMOwners.Allocations;
+    std::vector<window_info> &NewWindowLst = WindowBuffers.Back;
     CFIndex OsxWindowCount = CFArrayGetCount(OsxWindowLst);
+    if((std::size_t)OsxWindowCount > NewWindowLst.capacity())
+        ++WindowBuffers.Allocations;
+
+    NewWindowLst.resize(OsxWindowCount);
     for(CFIndex WindowIndex = 0; WindowIndex < OsxWindowCount; ++WindowIndex)
     {
         CFDictionaryRef Elem = (CFDictionaryRef)CFArrayGetValueAtIndex(OsxWindowLst, WindowIndex);
-        WindowLst.push_back(window_info());
-        CFDictionaryApplyFunction(Elem, GetWindowInfo, NULL);
+        std::size_t Capacity = NewWindowLst[WindowIndex].Name.capacity();
+        GetWindowInfo(Elem, &NewWindowLst[WindowIndex]);
+        if(NewWindowLst[WindowIndex].Name.capacity() != Capacity)
+            ++WindowBuffers.Allocations;
     }
     CFRelease(OsxWindowLst);
 
+    WindowLst.swap(NewWindowLst);
+    InvalidateWindowGrid();
+    RecordLatency(StatUpdateEnumerate, Start);
+    Allocations = WindowBuffers.Allocations + KWMOwners.Allocations - Allocations;
+    if(Allocations)
+        DEBUG("UpdateActiveWindowList() " << Allocations << " window list allocations")
+    PruneWindowRefCache();
+    PruneWindowClassCache();
+
     bool WindowBelowCursor = IsAnyWindowBelowCursor();
     KWMScreen.ForceRefreshFocus = true;
     KWMScreen.PrevSpace = Screen->ActiveSpace;
@@ -481,6 +726,7 @@ void UpdateActiveWindowList(screen_info *Screen)
     if(Screen->ForceContainerUpdate)
     {
         space_info *Space = &Screen->Space[Screen->ActiveSpace];
+        MarkNodeContainersDirty(Space->RootNode, Space->Mode);
         ApplyNodeContainer(Space->RootNode, Space->Mode);
         Screen->ForceContainerUpdate = false;
     }
@@ -531,23 +777,6 @@ void CreateWindowNodeTree(screen_info *Screen, std::vector<window_info*> *Window
     {
         Space = &Screen->Space[Screen->ActiveSpace];
         Space->RootNode = CreateTreeFromWindowIDList(Screen, Windows);
-        if(Space->RootNode)
-        {
-            if(Space->Mode == SpaceModeBSP)
-            {
-                SetRootNodeContainer(Screen, Space->RootNode);
-                CreateNodeContainers(Screen, Space->RootNode, true);
-            }
-            else if(Space->Mode == SpaceModeMonocle)
-            {
-                tree_node *CurrentNode = Space->RootNode;
-                while(CurrentNode)
-                {
-                    SetRootNodeContainer(Screen, CurrentNode);
-                    CurrentNode = CurrentNode->RightChild;
-                }
-            }
-        }
     }
 
     if(Space->RootNode)
@@ -559,79 +788,107 @@ void CreateWindowNodeTree(screen_info *Screen, std::vector<window_info*> *Window
 
 void ShouldWindowNodeTreeUpdate(screen_info *Screen)
 {
-    if(Screen->ActiveSpace == -1 || KWMScreen.PrevSpace != Screen->ActiveSpace || Screen->OldWindowListCount == -1)
+    if(Screen->ActiveSpace == -1 || KWMScreen.PrevSpace != Screen->ActiveSpace || !Screen->OldWindowListValid)
         return;
 
     space_info *Space = &Screen->Space[Screen->ActiveSpace];
+    window_delta Delta;
+    kwm_time_point Start = std::chrono::steady_clock::now();
+    GetWindowListDelta(Space, &Delta);
+    RecordLatency(StatUpdateReconcile, Start);
+    if(Delta.Added.empty() && Delta.Removed.empty())
+        return;
+
     if(Space->Mode == SpaceModeBSP)
-        ShouldBSPTreeUpdate(Screen, Space);
+        ShouldBSPTreeUpdate(Screen, Space, &Delta);
     else if(Space->Mode == SpaceModeMonocle)
-        ShouldMonocleTreeUpdate(Screen, Space);
+        ShouldMonocleTreeUpdate(Screen, Space, &Delta);
+
+    if(!Space->RootNode && !Delta.Added.empty())
+    {
+        std::vector<window_info*> WindowsOnDisplay = GetAllWindowsOnDisplay(Screen->ID);
+        if(!WindowsOnDisplay.empty())
+            CreateWindowNodeTree(Screen, &WindowsOnDisplay);
+    }
 }
 
-void ShouldBSPTreeUpdate(screen_info *Screen, space_info *Space)
+// The window list is reconciled with the tree rather than with the list of
+// the previous pass, so a window that was listed while tiling was skipped
+// (space transitions, Mission Control, tiling disabled) is still added.
+void GetWindowListDelta(space_info *Space, window_delta *Delta)
 {
-    if(WindowLst.size() > Screen->OldWindowListCount)
+    std::vector<int> &WindowIDs = WindowBuffers.WindowIDs;
+    WindowIDs.clear();
+    for(std::size_t WindowIndex = 0; WindowIndex < WindowLst.size(); ++WindowIndex)
     {
-        DEBUG("ShouldBSPTreeUpdate() Add Window")
-        for(std::size_t WindowIndex = 0; WindowIndex < WindowLst.size(); ++WindowIndex)
-        {
-            if(GetNodeFromWindowID(Space->RootNode, WindowLst[WindowIndex].WID, Space->Mode) == NULL)
-            {
-                if(!IsApplicationFloating(&WindowLst[WindowIndex]) &&
-                   !IsWindowFloating(WindowLst[WindowIndex].WID, NULL))
-                {
-                    tree_node *Insert = GetFirstPseudoLeafNode(Space->RootNode);
-                    if(Insert)
-                    {
-                        Insert->WindowID = WindowLst[WindowIndex].WID;
-                        ApplyNodeContainer(Insert, SpaceModeBSP);
-                    }
-                    else
-                    {
-                        AddWindowToBSPTree(Screen, WindowLst[WindowIndex].WID);
-                    }
+        window_info *Window = &WindowLst[WindowIndex];
+        WindowIDs.push_back(Window->WID);
 
-                    SetWindowFocus(&WindowLst[WindowIndex]);
-                    MoveCursorToCenterOfFocusedWindow();
-                }
-            }
-        }
+        if(GetNodeFromWindowID(Space, Window->WID) == NULL &&
+           !IsApplicationFloating(Window) &&
+           !IsWindowFloating(Window->WID))
+            Delta->Added.push_back(Window);
+    }
+
+    std::sort(WindowIDs.begin(), WindowIDs.end());
+
+    tree_node *CurrentNode = Space->Mode == SpaceModeBSP ? GetFirstLeafNode(Space->RootNode) : Space->RootNode;
+    while(CurrentNode)
+    {
+        if(CurrentNode->WindowID != -1 && !std::binary_search(WindowIDs.begin(), WindowIDs.end(), CurrentNode->WindowID))
+            Delta->Removed.push_back(CurrentNode->WindowID);
+
+        CurrentNode = GetNearestNodeToTheRight(CurrentNode, Space->Mode);
     }
-    else if(WindowLst.size() < Screen->OldWindowListCount)
+}
+
+void ShouldBSPTreeUpdate(screen_info *Screen, space_info *Space, window_delta *Delta)
+{
+    int FocusID = -1;
+    for(std::size_t IDIndex = 0; IDIndex < Delta->Removed.size(); ++IDIndex)
     {
+        tree_node *WindowNode = GetNodeFromWindowID(Space, Delta->Removed[IDIndex]);
+        if(!WindowNode)
+            continue;
+
         DEBUG("ShouldBSPTreeUpdate() Remove Window")
-        std::vector<int> WindowIDsInTree;
+        tree_node *NewFocusNode = NULL;
+        if(DetachWindowFromBSPTree(Screen, WindowNode, &NewFocusNode))
+            FocusID = NewFocusNode->WindowID;
+    }
 
-        tree_node *CurrentNode = GetFirstLeafNode(Space->RootNode);
-        while(CurrentNode)
-        {
-            WindowIDsInTree.push_back(CurrentNode->WindowID);
-            CurrentNode = GetNearestNodeToTheRight(CurrentNode, SpaceModeBSP);
-        }
+    if(!Space->RootNode)
+        return;
 
-        for(std::size_t IDIndex = 0; IDIndex < WindowIDsInTree.size(); ++IDIndex)
+    window_info *FocusWindow = NULL;
+    for(std::size_t WindowIndex = 0; WindowIndex < Delta->Added.size(); ++WindowIndex)
+    {
+        window_info *Window = Delta->Added[WindowIndex];
+        if(!IsApplicationFloating(Window) && !IsWindowFloating(Window->WID))
         {
-            bool Found = false;
-            for(std::size_t WindowIndex = 0; WindowIndex < WindowLst.size(); ++WindowIndex)
-            {
-                if(WindowLst[WindowIndex].WID == WindowIDsInTree[IDIndex])
-                {
-                    Found = true;
-                    break;
-                }
-            }
+            DEBUG("ShouldBSPTreeUpdate() Add Window")
+            tree_node *Insert = GetFirstPseudoLeafNode(Space->RootNode);
+            if(Insert)
+                SetNodeWindowID(Space, Insert, Window->WID);
+            else
+                InsertWindowIntoBSPTree(Screen, Window->WID);
 
-            if(!Found)
-                RemoveWindowFromBSPTree(Screen, WindowIDsInTree[IDIndex], false);
+            SetWindowFocus(Window);
+            FocusWindow = Window;
         }
     }
+
+    ApplyNodeContainer(Space->RootNode, SpaceModeBSP);
+    if(FocusWindow)
+        MoveCursorToCenterOfFocusedWindow();
+    else if(FocusID != -1)
+        SetWindowFocusByNode(GetNodeFromWindowID(Space, FocusID));
 }
 
-void AddWindowToBSPTree(screen_info *Screen, int WindowID)
+tree_node *InsertWindowIntoBSPTree(screen_info *Screen, int WindowID)
 {
     if(!Screen || !DoesSpaceExistInMapOfScreen(Screen))
-        return;
+        return NULL;
 
     space_info *Space = &Screen->Space[Screen->ActiveSpace];
     tree_node *RootNode = Space->RootNode;
@@ -642,26 +899,20 @@ void AddWindowToBSPTree(screen_info *Screen, int WindowID)
                                IsWindowOnActiveSpace(KWMFocus.Window->WID) &&
                                KWMFocus.Window->WID != WindowID;
 
-    bool DoNotUseMarkedContainer = IsWindowFloating(KWMScreen.MarkedWindow, NULL) ||
+    bool DoNotUseMarkedContainer = IsWindowFloating(KWMScreen.MarkedWindow) ||
                                    (KWMScreen.MarkedWindow == WindowID);
 
     if(KWMScreen.MarkedWindow == -1 && UseFocusedContainer)
     {
-        CurrentNode = GetNodeFromWindowID(RootNode, KWMFocus.Window->WID, Space->Mode);
+        CurrentNode = GetNodeFromWindowID(Space, KWMFocus.Window->WID);
     }
     else if(DoNotUseMarkedContainer || (KWMScreen.MarkedWindow == -1 && !UseFocusedContainer))
     {
-        while(!IsLeafNode(CurrentNode))
-        {
-            if(!IsLeafNode(CurrentNode->LeftChild) && IsLeafNode(CurrentNode->RightChild))
-                CurrentNode = CurrentNode->RightChild;
-            else
-                CurrentNode = CurrentNode->LeftChild;
-        }
+        CurrentNode = GetInsertionLeafNode(CurrentNode);
     }
     else
     {
-        CurrentNode = GetNodeFromWindowID(RootNode, KWMScreen.MarkedWindow, Space->Mode);
+        CurrentNode = GetNodeFromWindowID(Space, KWMScreen.MarkedWindow);
         KWMScreen.MarkedWindow = -1;
     }
 
@@ -669,8 +920,16 @@ void AddWindowToBSPTree(screen_info *Screen, int WindowID)
     {
         int SplitMode = KWMScreen.SplitMode == -1 ? GetOptimalSplitMode(CurrentNode) : KWMScreen.SplitMode;
         CreateLeafNodePair(Screen, CurrentNode, CurrentNode->WindowID, WindowID, SplitMode);
-        ApplyNodeContainer(CurrentNode, Space->Mode);
     }
+
+    return CurrentNode;
+}
+
+void AddWindowToBSPTree(screen_info *Screen, int WindowID)
+{
+    tree_node *CurrentNode = InsertWindowIntoBSPTree(Screen, WindowID);
+    if(CurrentNode)
+        ApplyNodeContainer(CurrentNode, Screen->Space[Screen->ActiveSpace].Mode);
 }
 
 void AddWindowToBSPTree()
@@ -681,16 +940,9 @@ void AddWindowToBSPTree()
     AddWindowToBSPTree(KWMScreen.Current, KWMFocus.Window->WID);
 }
 
-void RemoveWindowFromBSPTree(screen_info *Screen, int WindowID, bool Center)
+tree_node *DetachWindowFromBSPTree(screen_info *Screen, tree_node *WindowNode, tree_node **FocusNode)
 {
-    if(!DoesSpaceExistInMapOfScreen(Screen))
-        return;
-
     space_info *Space = &Screen->Space[Screen->ActiveSpace];
-    tree_node *WindowNode = GetNodeFromWindowID(Space->RootNode, WindowID, Space->Mode);
-    if(!WindowNode)
-        return;
-
     tree_node *Parent = WindowNode->Parent;
     if(Parent && Parent->LeftChild && Parent->RightChild)
     {
@@ -700,7 +952,7 @@ void RemoveWindowFromBSPTree(screen_info *Screen, int WindowID, bool Center)
         Parent->RightChild = NULL;
 
         DEBUG("RemoveWindowFromBSPTree()")
-        Parent->WindowID = AccessChild->WindowID;
+        SetNodeWindowID(Space, WindowNode, -1);
         if(AccessChild->LeftChild && AccessChild->RightChild)
         {
             Parent->LeftChild = AccessChild->LeftChild;
@@ -709,34 +961,60 @@ void RemoveWindowFromBSPTree(screen_info *Screen, int WindowID, bool Center)
             Parent->RightChild = AccessChild->RightChild;
             Parent->RightChild->Parent = Parent;
 
+            LinkLeafNodes(WindowNode->PrevLeaf, WindowNode->NextLeaf);
             CreateNodeContainers(Screen, Parent, true);
             NewFocusNode = IsLeafNode(Parent->LeftChild) ? Parent->LeftChild : Parent->RightChild;
         }
-
-        free(AccessChild);
-        free(WindowNode);
-        ApplyNodeContainer(Parent, Space->Mode);
-
-        if(Center)
+        else if(AccessChild->NextLeaf == WindowNode)
         {
-            CenterWindow(Screen, KWMFocus.Window);
+            LinkLeafNodes(AccessChild->PrevLeaf, Parent);
+            LinkLeafNodes(Parent, WindowNode->NextLeaf);
         }
         else
         {
-            if(!NewFocusNode)
-                NewFocusNode = Parent;
-
-            SetWindowFocusByNode(NewFocusNode);
+            LinkLeafNodes(WindowNode->PrevLeaf, Parent);
+            LinkLeafNodes(Parent, AccessChild->NextLeaf);
         }
+
+        SetNodeWindowID(Space, Parent, AccessChild->WindowID);
+        ReleaseNode(&Space->Pool, AccessChild);
+        ReleaseNode(&Space->Pool, WindowNode);
+
+        *FocusNode = NewFocusNode ? NewFocusNode : Parent;
+        return Parent;
     }
     else if(!Parent)
     {
         DEBUG("RemoveWindowFromBSPTree()")
+        DestroyNodeTree(Space);
+    }
+
+    return NULL;
+}
+
+void RemoveWindowFromBSPTree(screen_info *Screen, int WindowID, bool Center)
+{
+    if(!DoesSpaceExistInMapOfScreen(Screen))
+        return;
+
+    space_info *Space = &Screen->Space[Screen->ActiveSpace];
+    tree_node *WindowNode = GetNodeFromWindowID(Space, WindowID);
+    if(!WindowNode)
+        return;
 
-        free(WindowNode);
-        Screen->Space[Screen->ActiveSpace].RootNode = NULL;
+    tree_node *NewFocusNode = NULL;
+    tree_node *Parent = DetachWindowFromBSPTree(Screen, WindowNode, &NewFocusNode);
+    if(Parent)
+    {
+        ApplyNodeContainer(Parent, Space->Mode);
         if(Center)
             CenterWindow(Screen, KWMFocus.Window);
+        else
+            SetWindowFocusByNode(NewFocusNode);
+    }
+    else if(!Space->RootNode && Center)
+    {
+        CenterWindow(Screen, KWMFocus.Window);
     }
 }
 
@@ -748,97 +1026,69 @@ void RemoveWindowFromBSPTree()
     RemoveWindowFromBSPTree(KWMScreen.Current, KWMFocus.Window->WID, true);
 }
 
-void ShouldMonocleTreeUpdate(screen_info *Screen, space_info *Space)
+void ShouldMonocleTreeUpdate(screen_info *Screen, space_info *Space, window_delta *Delta)
 {
-    if(WindowLst.size() > Screen->OldWindowListCount)
+    int FocusID = -1;
+    for(std::size_t IDIndex = 0; IDIndex < Delta->Removed.size(); ++IDIndex)
     {
-        DEBUG("ShouldMonocleTreeUpdate() Add Window")
-        for(std::size_t WindowIndex = 0; WindowIndex < WindowLst.size(); ++WindowIndex)
+        tree_node *WindowNode = GetNodeFromWindowID(Space, Delta->Removed[IDIndex]);
+        if(!WindowNode)
+            continue;
+
+        DEBUG("ShouldMonocleTreeUpdate() Remove Window")
+        if(WindowNode == Space->RootNode && !WindowNode->RightChild)
         {
-            if(GetNodeFromWindowID(Space->RootNode, WindowLst[WindowIndex].WID, Space->Mode) == NULL)
-            {
-                if(!IsApplicationFloating(&WindowLst[WindowIndex]))
-                {
-                    tree_node *CurrentNode = GetLastLeafNode(Space->RootNode);
-                    tree_node *NewNode = CreateRootNode();
-                    SetRootNodeContainer(Screen, NewNode);
+            DestroyNodeTree(Space);
+            return;
+        }
 
-                    NewNode->WindowID = WindowLst[WindowIndex].WID;
-                    CurrentNode->RightChild = NewNode;
-                    NewNode->LeftChild = CurrentNode;
+        tree_node *NewFocusNode = NULL;
+        tree_node *Prev = WindowNode->LeftChild;
+        tree_node *Next = WindowNode->RightChild;
 
-                    ApplyNodeContainer(NewNode, SpaceModeMonocle);
-                    SetWindowFocus(&WindowLst[WindowIndex]);
-                }
-            }
+        if(Prev)
+        {
+            Prev->RightChild = Next;
+            NewFocusNode = Prev;
         }
-    }
-    else if(WindowLst.size() < Screen->OldWindowListCount)
-    {
-        DEBUG("ShouldMonocleTreeUpdate() Remove Window")
-        std::vector<int> WindowIDsInTree;
 
-        tree_node *CurrentNode = Space->RootNode;
-        while(CurrentNode)
+        if(Next)
+            Next->LeftChild = Prev;
+
+        if(WindowNode == Space->RootNode)
         {
-            WindowIDsInTree.push_back(CurrentNode->WindowID);
-            CurrentNode = GetNearestNodeToTheRight(CurrentNode, SpaceModeMonocle);
+            Space->RootNode = Next;
+            NewFocusNode = Next;
         }
 
-        if(WindowIDsInTree.size() >= 2)
-        {
-            for(std::size_t IDIndex = 0; IDIndex < WindowIDsInTree.size(); ++IDIndex)
-            {
-                bool Found = false;
-                for(std::size_t WindowIndex = 0; WindowIndex < WindowLst.size(); ++WindowIndex)
-                {
-                    if(WindowLst[WindowIndex].WID == WindowIDsInTree[IDIndex])
-                    {
-                        Found = true;
-                        break;
-                    }
-                }
+        SetNodeWindowID(Space, WindowNode, -1);
+        ReleaseNode(&Space->Pool, WindowNode);
+        FocusID = NewFocusNode ? NewFocusNode->WindowID : -1;
+    }
 
-                if(!Found)
-                {
-                    tree_node *WindowNode = GetNodeFromWindowID(Space->RootNode, WindowIDsInTree[IDIndex], SpaceModeMonocle);
-                    if(!WindowNode)
-                        return;
-
-                    tree_node *NewFocusNode = NULL;
-                    tree_node *Prev = WindowNode->LeftChild;
-                    tree_node *Next = WindowNode->RightChild;
-
-                    if(Prev)
-                    {
-                        Prev->RightChild = Next;
-                        NewFocusNode = Prev;
-                    }
-
-                    if(Next)
-                        Next->LeftChild = Prev;
-
-                    if(WindowNode == Space->RootNode)
-                    {
-                        Space->RootNode = Next;
-                        NewFocusNode = Next;
-                    }
-
-                    free(WindowNode);
-                    SetWindowFocusByNode(NewFocusNode);
-                }
-            }
-        }
-        else
+    window_info *FocusWindow = NULL;
+    for(std::size_t WindowIndex = 0; WindowIndex < Delta->Added.size(); ++WindowIndex)
+    {
+        window_info *Window = Delta->Added[WindowIndex];
+        if(!IsApplicationFloating(Window))
         {
-            tree_node *WindowNode = GetNodeFromWindowID(Space->RootNode, WindowIDsInTree[0], SpaceModeMonocle);
-            if(!WindowNode)
-                return;
+            DEBUG("ShouldMonocleTreeUpdate() Add Window")
+            tree_node *CurrentNode = GetLastLeafNode(Space->RootNode);
+            tree_node *NewNode = CreateRootNode(Screen);
+            SetRootNodeContainer(Screen, NewNode);
 
-            free(WindowNode);
-            Space->RootNode = NULL;
+            SetNodeWindowID(Space, NewNode, Window->WID);
+            CurrentNode->RightChild = NewNode;
+            NewNode->LeftChild = CurrentNode;
+            FocusWindow = Window;
         }
     }
+
+    ApplyNodeContainer(Space->RootNode, SpaceModeMonocle);
+    if(FocusWindow)
+        SetWindowFocus(FocusWindow);
+    else if(FocusID != -1)
+        SetWindowFocusByNode(GetNodeFromWindowID(Space, FocusID));
 }
 
 void AddWindowToTreeOfUnfocusedMonitor(screen_info *Screen, window_info *Window)
@@ -859,16 +1109,7 @@ void AddWindowToTreeOfUnfocusedMonitor(screen_info *Screen, window_info *Window)
         if(Space->Mode == SpaceModeBSP)
         {
             DEBUG("AddWindowToTreeOfUnfocusedMonitor() BSP Space")
-            tree_node *RootNode = Space->RootNode;
-            tree_node *CurrentNode = RootNode;
-
-            while(!IsLeafNode(CurrentNode))
-            {
-                if(!IsLeafNode(CurrentNode->LeftChild) && IsLeafNode(CurrentNode->RightChild))
-                    CurrentNode = CurrentNode->RightChild;
-                else
-                    CurrentNode = CurrentNode->LeftChild;
-            }
+            tree_node *CurrentNode = GetInsertionLeafNode(Space->RootNode);
 
             int SplitMode = KWMScreen.SplitMode == -1 ? GetOptimalSplitMode(CurrentNode) : KWMScreen.SplitMode;
             CreateLeafNodePair(Screen, CurrentNode, CurrentNode->WindowID, Window->WID, SplitMode);
@@ -879,10 +1120,10 @@ void AddWindowToTreeOfUnfocusedMonitor(screen_info *Screen, window_info *Window)
         {
             DEBUG("AddWindowToTreeOfUnfocusedMonitor() Monocle Space")
             tree_node *CurrentNode = GetLastLeafNode(Space->RootNode);
-            tree_node *NewNode = CreateRootNode();
+            tree_node *NewNode = CreateRootNode(Screen);
             SetRootNodeContainer(Screen, NewNode);
 
-            NewNode->WindowID = Window->WID;
+            SetNodeWindowID(Space, NewNode, Window->WID);
             CurrentNode->RightChild = NewNode;
             NewNode->LeftChild = CurrentNode;
             ResizeWindowToContainerSize(NewNode);
@@ -905,8 +1146,7 @@ void FloatFocusedSpace()
        FilterWindowList(KWMScreen.Current))
     {
         space_info *Space = &KWMScreen.Current->Space[KWMScreen.Current->ActiveSpace];
-        DestroyNodeTree(Space->RootNode, Space->Mode);
-        Space->RootNode = NULL;
+        DestroyNodeTree(Space);
         Space->Mode = SpaceModeFloating;
     }
 }
@@ -924,9 +1164,7 @@ void TileFocusedSpace(space_tiling_option Mode)
         if(Space->Mode == Mode)
             return;
 
-        DestroyNodeTree(Space->RootNode, Space->Mode);
-        Space->RootNode = NULL;
-
+        DestroyNodeTree(Space);
         Space->Mode = Mode;
         std::vector<window_info*> WindowsOnDisplay = GetAllWindowsOnDisplay(KWMScreen.Current->ID);
         CreateWindowNodeTree(KWMScreen.Current, &WindowsOnDisplay);
@@ -950,15 +1188,14 @@ void ToggleFocusedWindowFloating()
        IsWindowOnActiveSpace(KWMFocus.Window->WID) &&
        KWMScreen.Current->Space[KWMScreen.Current->ActiveSpace].Mode == SpaceModeBSP)
     {
-        int WindowIndex;
-        if(IsWindowFloating(KWMFocus.Window->WID, &WindowIndex))
+        if(IsWindowFloating(KWMFocus.Window->WID))
         {
-            FloatingWindowLst.erase(FloatingWindowLst.begin() + WindowIndex);
+            FloatingWindowLst.erase(KWMFocus.Window->WID);
             AddWindowToBSPTree();
         }
         else
         {
-            FloatingWindowLst.push_back(KWMFocus.Window->WID);
+            FloatingWindowLst.insert(KWMFocus.Window->WID);
             RemoveWindowFromBSPTree();
         }
     }
@@ -973,19 +1210,19 @@ void ToggleFocusedWindowParentContainer()
     if(Space->Mode != SpaceModeBSP)
         return;
 
-    tree_node *Node = GetNodeFromWindowID(Space->RootNode, KWMFocus.Window->WID, Space->Mode);
+    tree_node *Node = GetNodeFromWindowID(Space, KWMFocus.Window->WID);
     if(Node && Node->Parent)
     {
         if(IsLeafNode(Node) && Node->Parent->WindowID == -1)
         {
             DEBUG("ToggleFocusedWindowParentContainer() Set Parent Container")
-            Node->Parent->WindowID = Node->WindowID;
+            SetNodeWindowID(Space, Node->Parent, Node->WindowID);
             ResizeWindowToContainerSize(Node->Parent);
         }
         else
         {
             DEBUG("ToggleFocusedWindowParentContainer() Restore Window Container")
-            Node->Parent->WindowID = -1;
+            SetNodeWindowID(Space, Node->Parent, -1);
             ResizeWindowToContainerSize(Node);
         }
     }
@@ -1002,20 +1239,20 @@ void ToggleFocusedWindowFullscreen()
         tree_node *Node;
         if(Space->RootNode->WindowID == -1)
         {
-            Node = GetNodeFromWindowID(Space->RootNode, KWMFocus.Window->WID, Space->Mode);
+            Node = GetNodeFromWindowID(Space, KWMFocus.Window->WID);
             if(Node)
             {
                 DEBUG("ToggleFocusedWindowFullscreen() Set fullscreen")
-                Space->RootNode->WindowID = Node->WindowID;
+                SetNodeWindowID(Space, Space->RootNode, Node->WindowID);
                 ResizeWindowToContainerSize(Space->RootNode);
             }
         }
         else
         {
             DEBUG("ToggleFocusedWindowFullscreen() Restore old size")
-            Space->RootNode->WindowID = -1;
+            SetNodeWindowID(Space, Space->RootNode, -1);
 
-            Node = GetNodeFromWindowID(Space->RootNode, KWMFocus.Window->WID, Space->Mode);
+            Node = GetNodeFromWindowID(Space, KWMFocus.Window->WID);
             if(Node)
                 ResizeWindowToContainerSize(Node);
         }
@@ -1030,13 +1267,13 @@ void SwapFocusedWindowWithMarked()
     if(KWMScreen.Current && DoesSpaceExistInMapOfScreen(KWMScreen.Current))
     {
         space_info *Space = &KWMScreen.Current->Space[KWMScreen.Current->ActiveSpace];
-        tree_node *FocusedWindowNode = GetNodeFromWindowID(Space->RootNode, KWMFocus.Window->WID, Space->Mode);
+        tree_node *FocusedWindowNode = GetNodeFromWindowID(Space, KWMFocus.Window->WID);
         if(FocusedWindowNode)
         {
-            tree_node *NewFocusNode = GetNodeFromWindowID(Space->RootNode, KWMScreen.MarkedWindow, Space->Mode);
+            tree_node *NewFocusNode = GetNodeFromWindowID(Space, KWMScreen.MarkedWindow);
             if(NewFocusNode)
             {
-                SwapNodeWindowIDs(FocusedWindowNode, NewFocusNode);
+                SwapNodeWindowIDs(Space, FocusedWindowNode, NewFocusNode);
                 MoveCursorToCenterOfFocusedWindow();
             }
         }
@@ -1051,7 +1288,7 @@ void SwapFocusedWindowWithNearest(int Shift)
         return;
 
     space_info *Space = &KWMScreen.Current->Space[KWMScreen.Current->ActiveSpace];
-    tree_node *FocusedWindowNode = GetNodeFromWindowID(Space->RootNode, KWMFocus.Window->WID, Space->Mode);
+    tree_node *FocusedWindowNode = GetNodeFromWindowID(Space, KWMFocus.Window->WID);
     if(FocusedWindowNode)
     {
         tree_node *NewFocusNode = NULL;;
@@ -1063,7 +1300,7 @@ void SwapFocusedWindowWithNearest(int Shift)
 
         if(NewFocusNode)
         {
-            SwapNodeWindowIDs(FocusedWindowNode, NewFocusNode);
+            SwapNodeWindowIDs(Space, FocusedWindowNode, NewFocusNode);
             MoveCursorToCenterOfFocusedWindow();
         }
     }
@@ -1075,7 +1312,7 @@ void ShiftWindowFocus(int Shift)
         return;
 
     space_info *Space = &KWMScreen.Current->Space[KWMScreen.Current->ActiveSpace];
-    tree_node *FocusedWindowNode = GetNodeFromWindowID(Space->RootNode, KWMFocus.Window->WID, Space->Mode);
+    tree_node *FocusedWindowNode = GetNodeFromWindowID(Space, KWMFocus.Window->WID);
     if(FocusedWindowNode)
     {
         tree_node *FocusNode = NULL;
@@ -1147,9 +1384,13 @@ void MarkWindowContainer()
 
 void CloseWindowByRef(AXUIElementRef WindowRef)
 {
-    AXUIElementRef ActionClose;
-    AXUIElementCopyAttributeValue(WindowRef, kAXCloseButtonAttribute, (CFTypeRef*)&ActionClose);
-    AXUIElementPerformAction(ActionClose, kAXPressAction);
+    AXUIElementRef ActionClose = NULL;
+    CopyAXAttribute(WindowRef, kAXCloseButtonAttribute, (CFTypeRef*)&ActionClose);
+    if(ActionClose)
+    {
+        PerformAXAction(ActionClose, kAXPressAction);
+        CFRelease(ActionClose);
+    }
 }
 
 void CloseWindow(window_info *Window)
@@ -1168,9 +1409,9 @@ void SetWindowRefFocus(AXUIElementRef WindowRef, window_info *Window)
     KWMFocus.Cache = *Window;
     KWMFocus.Window = &KWMFocus.Cache;
 
-    AXUIElementSetAttributeValue(WindowRef, kAXMainAttribute, kCFBooleanTrue);
-    AXUIElementSetAttributeValue(WindowRef, kAXFocusedAttribute, kCFBooleanTrue);
-    AXUIElementPerformAction(WindowRef, kAXRaiseAction);
+    SetAXAttribute(WindowRef, kAXMainAttribute, kCFBooleanTrue);
+    SetAXAttribute(WindowRef, kAXFocusedAttribute, kCFBooleanTrue);
+    PerformAXAction(WindowRef, kAXRaiseAction);
 
     if(KwmFocusMode != FocusModeAutofocus)
         SetFrontProcessWithOptions(&KWMFocus.PSN, kSetFrontProcessFrontWindowOnly);
@@ -1203,26 +1444,8 @@ void SetWindowFocusByNode(tree_node *Node)
 
 void SetWindowDimensions(AXUIElementRef WindowRef, window_info *Window, int X, int Y, int Width, int Height)
 {
-    CGPoint WindowPos = CGPointMake(X, Y);
-    CFTypeRef NewWindowPos = (CFTypeRef)AXValueCreate(kAXValueCGPointType, (const void*)&WindowPos);
-
-    CGSize WindowSize = CGSizeMake(Width, Height);
-    CFTypeRef NewWindowSize = (CFTypeRef)AXValueCreate(kAXValueCGSizeType, (void*)&WindowSize);
-
-    AXUIElementSetAttributeValue(WindowRef, kAXPositionAttribute, NewWindowPos);
-    AXUIElementSetAttributeValue(WindowRef, kAXSizeAttribute, NewWindowSize);
-
-    Window->X = X;
-    Window->Y = Y;
-    Window->Width = Width;
-    Window->Height = Height;
-
-    DEBUG("SetWindowDimensions() Window " << Window->Name << ": " << Window->X << "," << Window->Y)
-
-    if(NewWindowPos != NULL)
-        CFRelease(NewWindowPos);
-    if(NewWindowSize != NULL)
-        CFRelease(NewWindowSize);
+    int Skipped = ApplyWindowFrame(WindowRef, Window, X, Y, Width, Height);
+    DEBUG("SetWindowDimensions() Window " << Window->Name << ": " << Window->X << "," << Window->Y << " (" << Skipped << " writes skipped)")
 }
 
 void CenterWindow(screen_info *Screen, window_info *Window)
@@ -1247,7 +1470,7 @@ void ModifyContainerSplitRatio(double Offset)
         if(IsLeafNode(Root) || Root->WindowID != -1)
             return;
 
-        tree_node *Node = GetNodeFromWindowID(Root, KWMFocus.Window->WID, Space->Mode);
+        tree_node *Node = GetNodeFromWindowID(Space, KWMFocus.Window->WID);
         if(Node && Node->Parent)
         {
             if(Node->Parent->SplitRatio + Offset > 0.0 &&
@@ -1261,7 +1484,17 @@ void ModifyContainerSplitRatio(double Offset)
     }
 }
 
+// Goes through the dispatch so that a write that did not go through leaves
+// the node dirty, and is retried with the next apply.
 void ResizeWindowToContainerSize(tree_node *Node)
+{
+    QueueWindowFrame(Node);
+    DispatchWindowFrames();
+}
+
+// The write itself is made by DispatchWindowFrames, together with the other
+// windows of the same apply step.
+void QueueWindowFrame(tree_node *Node)
 {
     window_info *Window = GetWindowByID(Node->WindowID);
 
@@ -1270,12 +1503,10 @@ void ResizeWindowToContainerSize(tree_node *Node)
         AXUIElementRef WindowRef;
         if(GetWindowRef(Window, &WindowRef))
         {
-            SetWindowDimensions(WindowRef, Window,
-                        Node->Container.X, Node->Container.Y, 
-                        Node->Container.Width, Node->Container.Height);
-
-            if(WindowsAreEqual(Window, KWMFocus.Window))
-                KWMFocus.Cache = *Window;
+            frame_write Write = { Window->PID, WindowRef, Window, Node,
+                                  (int)Node->Container.X, (int)Node->Container.Y,
+                                  (int)Node->Container.Width, (int)Node->Container.Height };
+            KWMDispatch.Writes.push_back(Write);
         }
         else
         {
@@ -1291,13 +1522,46 @@ void ResizeWindowToContainerSize()
         if(KWMScreen.Current && DoesSpaceExistInMapOfScreen(KWMScreen.Current))
         {
             space_info *Space = &KWMScreen.Current->Space[KWMScreen.Current->ActiveSpace];
-            tree_node *Node = GetNodeFromWindowID(Space->RootNode, KWMFocus.Window->WID, Space->Mode);
+            tree_node *Node = GetNodeFromWindowID(Space, KWMFocus.Window->WID);
             if(Node)
                 ResizeWindowToContainerSize(Node);
         }
     }
 }
 
+// Rotations only accumulate on the space and are resolved by the next
+// layout pass. Rotating by 90 degrees four times is the identity, so a
+// burst of rotations costs a single pass and may not move any window.
+void RotateWindowTree(screen_info *Screen, int Deg)
+{
+    if(Screen && DoesSpaceExistInMapOfScreen(Screen))
+    {
+        space_info *Space = &Screen->Space[Screen->ActiveSpace];
+        if(Space->Mode == SpaceModeBSP)
+            Space->Rotation = (Space->Rotation + Deg) % 360;
+    }
+}
+
+void ApplyPendingTreeRotation(screen_info *Screen)
+{
+    if(Screen && DoesSpaceExistInMapOfScreen(Screen))
+    {
+        space_info *Space = &Screen->Space[Screen->ActiveSpace];
+        if(Space->Rotation != 0)
+        {
+            DEBUG("ApplyPendingTreeRotation() " << Space->Rotation << " degrees")
+            if(Space->Mode == SpaceModeBSP && Space->RootNode)
+            {
+                RotateTree(Space->RootNode, Space->Rotation);
+                CreateNodeContainers(Screen, Space->RootNode, false);
+                ApplyNodeContainer(Space->RootNode, Space->Mode);
+            }
+
+            Space->Rotation = 0;
+        }
+    }
+}
+
 CGPoint GetCursorPos()
 {
     CGEventRef Event = CGEventCreate(NULL);
@@ -1309,11 +1573,11 @@ CGPoint GetCursorPos()
 
 std::string GetWindowTitle(AXUIElementRef WindowRef)
 {
-    CFStringRef Temp;
+    CFStringRef Temp = NULL;
     std::string WindowTitle;
 
-    AXUIElementCopyAttributeValue(WindowRef, kAXTitleAttribute, (CFTypeRef*)&Temp);
-    if(CFStringGetCStringPtr(Temp, kCFStringEncodingMacRoman))
+    CopyAXAttribute(WindowRef, kAXTitleAttribute, (CFTypeRef*)&Temp);
+    if(Temp && CFStringGetCStringPtr(Temp, kCFStringEncodingMacRoman))
         WindowTitle = CFStringGetCStringPtr(Temp, kCFStringEncodingMacRoman);
 
     if(Temp != NULL)
@@ -1324,28 +1588,30 @@ std::string GetWindowTitle(AXUIElementRef WindowRef)
 
 CGSize GetWindowSize(AXUIElementRef WindowRef)
 {
-    AXValueRef Temp;
-    CGSize WindowSize;
-
-    AXUIElementCopyAttributeValue(WindowRef, kAXSizeAttribute, (CFTypeRef*)&Temp);
-    AXValueGetValue(Temp, kAXValueCGSizeType, &WindowSize);
+    AXValueRef Temp = NULL;
+    CGSize WindowSize = {};
 
+    CopyAXAttribute(WindowRef, kAXSizeAttribute, (CFTypeRef*)&Temp);
     if(Temp != NULL)
+    {
+        AXValueGetValue(Temp, kAXValueCGSizeType, &WindowSize);
         CFRelease(Temp);
+    }
 
     return WindowSize;
 }
 
 CGPoint GetWindowPos(AXUIElementRef WindowRef)
 {
-    AXValueRef Temp;
-    CGPoint WindowPos;
-
-    AXUIElementCopyAttributeValue(WindowRef, kAXPositionAttribute, (CFTypeRef*)&Temp);
-    AXValueGetValue(Temp, kAXValueCGPointType, &WindowPos);
+    AXValueRef Temp = NULL;
+    CGPoint WindowPos = {};
 
+    CopyAXAttribute(WindowRef, kAXPositionAttribute, (CFTypeRef*)&Temp);
     if(Temp != NULL)
+    {
+        AXValueGetValue(Temp, kAXValueCGPointType, &WindowPos);
         CFRelease(Temp);
+    }
 
     return WindowPos;
 }
@@ -1365,25 +1631,15 @@ bool GetWindowRole(window_info *Window, CFTypeRef *Role, CFTypeRef *SubRole)
 {
     bool Result = false;
 
-    std::map<int, window_role>::iterator It = WindowRoleCache.find(Window->WID);
-    if(It != WindowRoleCache.end())
+    AXUIElementRef WindowRef;
+    if(GetWindowRef(Window, &WindowRef))
     {
-        *Role = WindowRoleCache[Window->WID].Role;
-        *SubRole = WindowRoleCache[Window->WID].SubRole;
+        *Role = NULL;
+        *SubRole = NULL;
+        CopyAXAttribute(WindowRef, kAXRoleAttribute, (CFTypeRef *)Role);
+        CopyAXAttribute(WindowRef, kAXSubroleAttribute, (CFTypeRef *)SubRole);
         Result = true;
     }
-    else
-    {
-        AXUIElementRef WindowRef;
-        if(GetWindowRef(Window, &WindowRef))
-        {
-            AXUIElementCopyAttributeValue(WindowRef, kAXRoleAttribute, (CFTypeRef *)Role);
-            AXUIElementCopyAttributeValue(WindowRef, kAXSubroleAttribute, (CFTypeRef *)SubRole);
-            window_role RoleEntry = { *Role, *SubRole };
-            WindowRoleCache[Window->WID] = RoleEntry;
-            Result = true;
-        }
-    }
 
     return Result;
 }
@@ -1400,92 +1656,109 @@ bool GetWindowRef(window_info *Window, AXUIElementRef *WindowRef)
         return false;
     }
 
-    CFArrayRef AppWindowLst;
-    AXUIElementCopyAttributeValue(App, kAXWindowsAttribute, (CFTypeRef*)&AppWindowLst);
+    CFArrayRef AppWindowLst = NULL;
+    CopyAXAttribute(App, kAXWindowsAttribute, (CFTypeRef*)&AppWindowLst);
+    CFRelease(App);
     if(!AppWindowLst)
     {
         DEBUG("GetWindowRef() Could not get AppWindowLst")
         return false;
     }
 
-    bool Found = false;
-    FreeWindowRefCache(Window->PID);
+    std::map<int, AXUIElementRef> &Elements = WindowRefsCache.Elements[Window->PID];
     CFIndex AppWindowCount = CFArrayGetCount(AppWindowLst);
     for(CFIndex WindowIndex = 0; WindowIndex < AppWindowCount; ++WindowIndex)
     {
         AXUIElementRef AppWindowRef = (AXUIElementRef)CFArrayGetValueAtIndex(AppWindowLst, WindowIndex);
-        if(AppWindowRef != NULL)
+        int AppWindowRefWID = -1;
+        if(AppWindowRef != NULL &&
+           _AXUIElementGetWindow(AppWindowRef, &AppWindowRefWID) == kAXErrorSuccess &&
+           Elements.find(AppWindowRefWID) == Elements.end())
         {
-            WindowRefsCache[Window->PID].push_back(AppWindowRef);
-            if(!Found)
-            {
-                int AppWindowRefWID = -1;
-                _AXUIElementGetWindow(AppWindowRef, &AppWindowRefWID);
-                if(AppWindowRefWID == Window->WID)
-                {
-                    *WindowRef = AppWindowRef;
-                    Found = true;
-                }
-            }
+            CFRetain(AppWindowRef);
+            Elements[AppWindowRefWID] = AppWindowRef;
+            ++WindowRefsCache.Size;
         }
     }
+    CFRelease(AppWindowLst);
 
-    CFRelease(App);
-    return Found;
+    DEBUG("GetWindowRef() Cached " << Elements.size() << " windows of " << GetWindowOwner(Window) << " (" << WindowRefsCache.Size << " cached, " << WindowRefsCache.Hits << " hits, " << WindowRefsCache.Misses << " misses)")
+    std::map<int, AXUIElementRef>::iterator It = Elements.find(Window->WID);
+    if(It == Elements.end())
+        return false;
+
+    *WindowRef = It->second;
+    return true;
 }
 
-bool IsApplicationInCache(int PID, std::vector<AXUIElementRef> *Elements)
+bool GetWindowRefFromCache(window_info *Window, AXUIElementRef *WindowRef)
 {
-    bool Result = false;
-    std::map<int, std::vector<AXUIElementRef> >::iterator It = WindowRefsCache.find(PID);
-
-    if(It != WindowRefsCache.end())
+    std::map<int, std::map<int, AXUIElementRef> >::iterator App = WindowRefsCache.Elements.find(Window->PID);
+    if(App != WindowRefsCache.Elements.end())
     {
-        *Elements = It->second;
-        Result = true;
+        std::map<int, AXUIElementRef>::iterator It = App->second.find(Window->WID);
+        if(It != App->second.end())
+        {
+            *WindowRef = It->second;
+            ++WindowRefsCache.Hits;
+            return true;
+        }
     }
 
-    return Result;
+    ++WindowRefsCache.Misses;
+    return false;
 }
 
-bool GetWindowRefFromCache(window_info *Window, AXUIElementRef *WindowRef)
+void FreeWindowRefCache(int PID)
 {
-    bool Result = false;
-    std::vector<AXUIElementRef> Elements;
-    bool IsCached = IsApplicationInCache(Window->PID, &Elements);
-
-    if(IsCached)
+    std::map<int, std::map<int, AXUIElementRef> >::iterator App = WindowRefsCache.Elements.find(PID);
+    if(App != WindowRefsCache.Elements.end())
     {
-        for(std::size_t ElementIndex = 0; ElementIndex < Elements.size(); ++ElementIndex)
-        {
-            int AppWindowRefWID = -1;
-            _AXUIElementGetWindow(Elements[ElementIndex], &AppWindowRefWID);
-            if(AppWindowRefWID == Window->WID)
-            {
-                *WindowRef = Elements[ElementIndex];
-                Result = true;
-                break;
-            }
-        }
+        std::map<int, AXUIElementRef>::iterator It;
+        for(It = App->second.begin(); It != App->second.end(); ++It)
+            CFRelease(It->second);
+
+        WindowRefsCache.Size -= App->second.size();
+        WindowRefsCache.Elements.erase(App);
     }
+}
 
-    if(!IsCached)
-        WindowRefsCache[Window->PID] = std::vector<AXUIElementRef>();
+void GetSortedWindowIDs(std::vector<int> *WindowIDs)
+{
+    WindowIDs->clear();
+    for(std::size_t WindowIndex = 0; WindowIndex < WindowLst.size(); ++WindowIndex)
+        WindowIDs->push_back(WindowLst[WindowIndex].WID);
 
-    return Result;
+    std::sort(WindowIDs->begin(), WindowIDs->end());
 }
 
-void FreeWindowRefCache(int PID)
+void PruneWindowRefCache()
 {
-    std::map<int, std::vector<AXUIElementRef> >::iterator It = WindowRefsCache.find(PID);
+    std::vector<int> &WindowIDs = WindowBuffers.WindowIDs;
+    GetSortedWindowIDs(&WindowIDs);
 
-    if(It != WindowRefsCache.end())
+    std::map<int, std::map<int, AXUIElementRef> >::iterator App = WindowRefsCache.Elements.begin();
+    while(App != WindowRefsCache.Elements.end())
     {
-        int NumElements = WindowRefsCache[PID].size();
-        for(int RefIndex = 0; RefIndex < NumElements; ++RefIndex)
-            CFRelease(WindowRefsCache[PID][RefIndex]);
+        std::map<int, AXUIElementRef>::iterator It = App->second.begin();
+        while(It != App->second.end())
+        {
+            if(!std::binary_search(WindowIDs.begin(), WindowIDs.end(), It->first))
+            {
+                CFRelease(It->second);
+                App->second.erase(It++);
+                --WindowRefsCache.Size;
+            }
+            else
+            {
+                ++It;
+            }
+        }
 
-        WindowRefsCache[PID].clear();
+        if(App->second.empty())
+            WindowRefsCache.Elements.erase(App++);
+        else
+            ++App;
     }
 }
 
@@ -1493,12 +1766,12 @@ bool GetWindowFocusedByOSX(int *WindowWID)
 {
     static AXUIElementRef SystemWideElement = AXUIElementCreateSystemWide();
 
-    AXUIElementRef App;
-    AXUIElementCopyAttributeValue(SystemWideElement, kAXFocusedApplicationAttribute, (CFTypeRef*)&App);
+    AXUIElementRef App = NULL;
+    CopyAXAttribute(SystemWideElement, kAXFocusedApplicationAttribute, (CFTypeRef*)&App);
     if(App)
     {
         AXUIElementRef WindowRef;
-        AXError Error = AXUIElementCopyAttributeValue(App, kAXFocusedWindowAttribute, (CFTypeRef*)&WindowRef);
+        AXError Error = CopyAXAttribute(App, kAXFocusedWindowAttribute, (CFTypeRef*)&WindowRef);
         CFRelease(App);
 
         if (Error == kAXErrorSuccess)
@@ -1512,47 +1785,32 @@ bool GetWindowFocusedByOSX(int *WindowWID)
     return false;
 }
 
-void GetWindowInfo(const void *Key, const void *Value, void *Context)
+// The reader that GetWindowInfo uses for the dictionaries returned by
+// CGWindowListCopyWindowInfo. The keys are looked up directly, and numbers
+// are read as kCFNumberIntType, which is the type of every field.
+static CFStringRef WindowKeys[] = { kCGWindowNumber, kCGWindowOwnerPID, kCGWindowLayer, kCGWindowName, kCGWindowOwnerName };
+
+KWM_WINDOW_GET_NUMBER(CFGetWindowNumber)
+{
+    CFNumberRef Number = (CFNumberRef)CFDictionaryGetValue((CFDictionaryRef)Entry, WindowKeys[Key]);
+    return Number && CFNumberGetValue(Number, kCFNumberIntType, Value);
+}
+
+KWM_WINDOW_GET_STRING(CFGetWindowString)
 {
-    CFStringRef K = (CFStringRef)Key;
-    std::string KeyStr = CFStringGetCStringPtr(K, kCFStringEncodingMacRoman);
+    CFStringRef String = (CFStringRef)CFDictionaryGetValue((CFDictionaryRef)Entry, WindowKeys[Key]);
+    return String ? CFStringGetCStringPtr(String, kCFStringEncodingMacRoman) : NULL;
+}
 
-    CFTypeID ID = CFGetTypeID(Value);
-    if(ID == CFStringGetTypeID())
-    {
-        CFStringRef V = (CFStringRef)Value;
-        if(CFStringGetCStringPtr(V, kCFStringEncodingMacRoman))
-        {
-            std::string ValueStr = CFStringGetCStringPtr(V, kCFStringEncodingMacRoman);
-            if(KeyStr == "kCGWindowName")
-                WindowLst[WindowLst.size()-1].Name = ValueStr;
-            else if(KeyStr == "kCGWindowOwnerName")
-                WindowLst[WindowLst.size()-1].Owner = ValueStr;
-        }
-    }
-    else if(ID == CFNumberGetTypeID())
-    {
-        int MyInt;
-        CFNumberRef V = (CFNumberRef)Value;
-        CFNumberGetValue(V, kCFNumberSInt64Type, &MyInt);
-        if(KeyStr == "kCGWindowNumber")
-            WindowLst[WindowLst.size()-1].WID = MyInt;
-        else if(KeyStr == "kCGWindowOwnerPID")
-            WindowLst[WindowLst.size()-1].PID = MyInt;
-        else if(KeyStr == "kCGWindowLayer")
-            WindowLst[WindowLst.size()-1].Layer = MyInt;
-        else if(KeyStr == "X")
-            WindowLst[WindowLst.size()-1].X = MyInt;
-        else if(KeyStr == "Y")
-            WindowLst[WindowLst.size()-1].Y = MyInt;
-        else if(KeyStr == "Width")
-            WindowLst[WindowLst.size()-1].Width = MyInt;
-        else if(KeyStr == "Height")
-            WindowLst[WindowLst.size()-1].Height = MyInt;
-    }
-    else if(ID == CFDictionaryGetTypeID())
-    {
-        CFDictionaryRef Elem = (CFDictionaryRef)Value;
-        CFDictionaryApplyFunction(Elem, GetWindowInfo, NULL);
-    } 
+KWM_WINDOW_GET_BOUNDS(CFGetWindowBounds)
+{
+    CGRect Bounds = CGRectZero;
+    CFDictionaryRef BoundsDict = (CFDictionaryRef)CFDictionaryGetValue((CFDictionaryRef)Entry, kCGWindowBounds);
+    bool Result = BoundsDict && CGRectMakeWithDictionaryRepresentation(BoundsDict, &Bounds);
+
+    *X = Bounds.origin.x;
+    *Y = Bounds.origin.y;
+    *Width = Bounds.size.width;
+    *Height = Bounds.size.height;
+    return Result;
 }
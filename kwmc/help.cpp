@@ -19,6 +19,7 @@ void ShowUsage()
         "   write sentence                               Automatically emit keystrokes to the focused window\n"
         "   bind mod+mod+mod-key command                 Binds hotkeys on the fly (use `sys` prefix for non kwmc command)\n"
         "   unbind mod+mod+mod-key                       Unbinds hotkeys\n"
+        "   stats reset                                  Clear the latency histograms shown by 'read stats'\n"
         "\n"
         "For further help run:\n"
         "   kwmc help config|window|tree|space|screen|read\n"
@@ -37,6 +38,7 @@ void ShowHelp(std::string Command)
             "   launchd enable|disable                                 Let launchd manage Kwm (automatically start on login)\n"
             "   prefix mod+mod+mod-key                                 Set global prefix for all of Kwms hotkeys\n"
             "   prefix-timeout seconds                                 Set global prefix timeout in seconds (default: 0.75)\n"
+            "   ax-timeout seconds                                     Set timeout of accessibility calls in seconds (default: 1)\n"
             "   padding top|bottom|left|right value                    Set default padding\n"
             "   gap vertical|horizontal value                          Set default container gaps\n"
             "   capture id application                                 Capture application to screen\n"
@@ -44,6 +46,7 @@ void ShowHelp(std::string Command)
             "   focus toggle|autofocus|autoraise|disabled              Set focus-mode\n"
             "   cycle-focus screen|all|disabled                        Set wrap-around for 'window -f prev|next'\n"
             "   focus mouse-follows enable|disable                     Set state of mouse-follows-focus\n"
+            "   focus dwell seconds                                    Set time the cursor must rest on a window before it gets focus (default: 0)\n"
             "   tiling enable|disable                                  Should Kwm perform tiling\n"
             "   space bsp|monocle|float                                Set default tiling mode\n"
             "   hotkeys enable|disable                                 Set state of Kwm's hotkeys\n"
@@ -81,6 +84,8 @@ void ShowHelp(std::string Command)
             "   -c refresh                                             Resize all windows to container\n"
             "   save name                                              Save current bsp-tree to file ($HOME/.kwm/name)\n"
             "   restore name                                           Load current bsp-tree from file ($HOME/.kwm/name)\n"
+            "   convert name binary|text                               Convert saved bsp-tree file between binary and text format\n"
+            "   preload                                                Load every saved bsp-tree in $HOME/.kwm into memory\n"
         ;
     }
     else if (Command ==  "space")
@@ -120,6 +125,9 @@ void ShowHelp(std::string Command)
             "   mouse-follows                                          Get state of mouse-follows-focus\n"
             "   split-mode                                             Get the current mode used for binary splits\n"
             "   split-ratio                                            Get the current ratio used for binary splits\n"
+            "   tap-latency                                            Get latency of event-tap callbacks and coalesced mouse-moves\n"
+            "   ax-latency                                             Get latency of accessibility calls per application\n"
+            "   stats                                                  Get count, p50, p99 and max latency of each hot path\n"
         ;
     }
     else
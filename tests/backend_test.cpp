@@ -0,0 +1,162 @@
+#include "../kwm/backend.h"
+
+#include <iostream>
+#include <map>
+#include <stdint.h>
+
+// The fake backend counts the writes that reach each window, and fails every
+// write to the window in FailingWindow.
+kwm_backend KWMBackend;
+extern kwm_dispatch KWMDispatch;
+
+pthread_mutex_t FakeLock = PTHREAD_MUTEX_INITIALIZER;
+std::map<AXUIElementRef, int> PositionWrites;
+std::map<AXUIElementRef, int> SizeWrites;
+AXUIElementRef FailingWindow = NULL;
+int Failures = 0;
+
+KWM_WINDOW_SET_POSITION(FakeSetWindowPosition)
+{
+    pthread_mutex_lock(&FakeLock);
+    ++PositionWrites[WindowRef];
+    pthread_mutex_unlock(&FakeLock);
+    return WindowRef != FailingWindow;
+}
+
+KWM_WINDOW_SET_SIZE(FakeSetWindowSize)
+{
+    pthread_mutex_lock(&FakeLock);
+    ++SizeWrites[WindowRef];
+    pthread_mutex_unlock(&FakeLock);
+    return WindowRef != FailingWindow;
+}
+
+#define EXPECT(Condition) \
+    do { if(!(Condition)) { std::cout << __FILE__ << ":" << __LINE__ << ": expected " << #Condition << std::endl; ++Failures; } } while(0)
+
+AXUIElementRef GetFakeWindowRef(int WindowIndex)
+{
+    return (AXUIElementRef)(intptr_t)(WindowIndex + 1);
+}
+
+void QueueFrame(std::vector<window_info> *Windows, int WindowIndex, int X, int Y, int Width, int Height)
+{
+    window_info *Window = &(*Windows)[WindowIndex];
+    frame_write Write = { Window->PID, GetFakeWindowRef(WindowIndex), Window, NULL, X, Y, Width, Height };
+    KWMDispatch.Writes.push_back(Write);
+}
+
+std::vector<window_info> CreateWindows(int Count)
+{
+    std::vector<window_info> Windows(Count);
+    for(int WindowIndex = 0; WindowIndex < Count; ++WindowIndex)
+    {
+        window_info *Window = &Windows[WindowIndex];
+        Window->PID = 100 + WindowIndex % 3;
+        Window->WID = WindowIndex;
+        Window->X = WindowIndex * 100;
+        Window->Y = 0;
+        Window->Width = 100;
+        Window->Height = 100;
+    }
+
+    return Windows;
+}
+
+// Windows 0-2 move, 3-5 are resized, 6-7 do both and 8-9 keep their frame.
+void QueueRelayout(std::vector<window_info> *Windows)
+{
+    for(int WindowIndex = 0; WindowIndex < 10; ++WindowIndex)
+    {
+        int X = WindowIndex * 100;
+        int Width = 100;
+        if(WindowIndex < 3 || (WindowIndex >= 6 && WindowIndex < 8))
+            X += 10;
+        if(WindowIndex >= 3 && WindowIndex < 8)
+            Width += 10;
+
+        QueueFrame(Windows, WindowIndex, X, 0, Width, 100);
+    }
+}
+
+void ResetCounters()
+{
+    PositionWrites.clear();
+    SizeWrites.clear();
+    KWMBackend.Writes = 0;
+    KWMBackend.SkippedWrites = 0;
+}
+
+void TestRelayoutWritesChangedAttributesOnce()
+{
+    ResetCounters();
+    std::vector<window_info> Windows = CreateWindows(10);
+
+    QueueRelayout(&Windows);
+    EXPECT(WriteWindowFrames());
+    KWMDispatch.Writes.clear();
+
+    for(int WindowIndex = 0; WindowIndex < 10; ++WindowIndex)
+    {
+        bool Moved = WindowIndex < 3 || (WindowIndex >= 6 && WindowIndex < 8);
+        bool Resized = WindowIndex >= 3 && WindowIndex < 8;
+        EXPECT(PositionWrites[GetFakeWindowRef(WindowIndex)] == (Moved ? 1 : 0));
+        EXPECT(SizeWrites[GetFakeWindowRef(WindowIndex)] == (Resized ? 1 : 0));
+    }
+
+    EXPECT(KWMBackend.Writes == 10);
+    EXPECT(KWMBackend.SkippedWrites == 10);
+    EXPECT(Windows[0].X == 10 && Windows[3].Width == 110 && Windows[7].X == 710 && Windows[7].Width == 110);
+
+    ResetCounters();
+    QueueRelayout(&Windows);
+    EXPECT(!WriteWindowFrames());
+    KWMDispatch.Writes.clear();
+
+    EXPECT(PositionWrites.empty() && SizeWrites.empty());
+    EXPECT(KWMBackend.Writes == 0);
+    EXPECT(KWMBackend.SkippedWrites == 20);
+}
+
+void TestFailedWriteIsRetried()
+{
+    ResetCounters();
+    std::vector<window_info> Windows = CreateWindows(10);
+    FailingWindow = GetFakeWindowRef(6);
+
+    QueueRelayout(&Windows);
+    WriteWindowFrames();
+    KWMDispatch.Writes.clear();
+    EXPECT(Windows[6].X == 600 && Windows[6].Width == 100);
+
+    FailingWindow = NULL;
+    ResetCounters();
+    QueueRelayout(&Windows);
+    WriteWindowFrames();
+    KWMDispatch.Writes.clear();
+
+    EXPECT(PositionWrites.size() == 1 && PositionWrites[GetFakeWindowRef(6)] == 1);
+    EXPECT(SizeWrites.size() == 1 && SizeWrites[GetFakeWindowRef(6)] == 1);
+    EXPECT(Windows[6].X == 610 && Windows[6].Width == 110);
+}
+
+int main()
+{
+    KWMBackend.SetWindowPosition = FakeSetWindowPosition;
+    KWMBackend.SetWindowSize = FakeSetWindowSize;
+
+    TestRelayoutWritesChangedAttributesOnce();
+    TestFailedWriteIsRetried();
+
+    if(!KwmStartDispatchPool())
+    {
+        std::cout << "Could not create dispatch pool!" << std::endl;
+        return 1;
+    }
+
+    TestRelayoutWritesChangedAttributesOnce();
+    TestFailedWriteIsRetried();
+
+    std::cout << "backend_test: " << (Failures ? "FAILED" : "OK") << std::endl;
+    return Failures ? 1 : 0;
+}
@@ -0,0 +1,121 @@
+#include "../kwm/backend.h"
+
+#include <iostream>
+#include <chrono>
+#include <map>
+#include <stdint.h>
+#include <unistd.h>
+
+// The fake backend takes a fixed time per write, set per application. The
+// pid of a window is encoded in its window reference.
+kwm_backend KWMBackend;
+extern kwm_dispatch KWMDispatch;
+
+#define FAKE_APPS 5
+int WriteLatency[FAKE_APPS] = { 2, 5, 10, 20, 40 };
+
+pthread_mutex_t FakeLock = PTHREAD_MUTEX_INITIALIZER;
+std::map<int, std::vector<int> > WriteOrder;
+int Failures = 0;
+
+#define EXPECT(Condition) \
+    do { if(!(Condition)) { std::cout << __FILE__ << ":" << __LINE__ << ": expected " << #Condition << std::endl; ++Failures; } } while(0)
+
+void WriteFakeFrame(AXUIElementRef WindowRef)
+{
+    int WindowIndex = (int)(intptr_t)WindowRef % 100;
+    int PID = (int)(intptr_t)WindowRef / 100;
+    usleep(WriteLatency[PID] * 1000);
+
+    pthread_mutex_lock(&FakeLock);
+    WriteOrder[PID].push_back(WindowIndex);
+    pthread_mutex_unlock(&FakeLock);
+}
+
+KWM_WINDOW_SET_POSITION(FakeSetWindowPosition)
+{
+    WriteFakeFrame(WindowRef);
+    return true;
+}
+
+KWM_WINDOW_SET_SIZE(FakeSetWindowSize)
+{
+    WriteFakeFrame(WindowRef);
+    return true;
+}
+
+// Moves and resizes every window, so each one takes two writes.
+double TimeRelayout(std::vector<window_info> *Windows)
+{
+    WriteOrder.clear();
+    for(std::size_t WindowIndex = 0; WindowIndex < Windows->size(); ++WindowIndex)
+    {
+        window_info *Window = &(*Windows)[WindowIndex];
+        AXUIElementRef WindowRef = (AXUIElementRef)(intptr_t)(Window->PID * 100 + WindowIndex);
+        frame_write Write = { Window->PID, WindowRef, Window, NULL, Window->X + 1, Window->Y, Window->Width + 1, Window->Height };
+        KWMDispatch.Writes.push_back(Write);
+    }
+
+    std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+    WriteWindowFrames();
+    KWMDispatch.Writes.clear();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - Start).count();
+}
+
+bool AreWritesInQueuedOrder()
+{
+    std::map<int, std::vector<int> >::iterator It;
+    for(It = WriteOrder.begin(); It != WriteOrder.end(); ++It)
+    {
+        std::vector<int> &Order = It->second;
+        for(std::size_t WriteIndex = 1; WriteIndex < Order.size(); ++WriteIndex)
+        {
+            if(Order[WriteIndex] < Order[WriteIndex - 1])
+                return false;
+        }
+    }
+
+    return true;
+}
+
+int main()
+{
+    KWMBackend.SetWindowPosition = FakeSetWindowPosition;
+    KWMBackend.SetWindowSize = FakeSetWindowSize;
+
+    std::vector<window_info> Windows(20);
+    for(std::size_t WindowIndex = 0; WindowIndex < Windows.size(); ++WindowIndex)
+        Windows[WindowIndex].PID = WindowIndex % FAKE_APPS;
+
+    double AppTime[FAKE_APPS] = {};
+    for(std::size_t WindowIndex = 0; WindowIndex < Windows.size(); ++WindowIndex)
+        AppTime[Windows[WindowIndex].PID] += 2 * WriteLatency[Windows[WindowIndex].PID];
+
+    double Slowest = 0;
+    double Sum = 0;
+    for(int PID = 0; PID < FAKE_APPS; ++PID)
+    {
+        Slowest = std::max(Slowest, AppTime[PID]);
+        Sum += AppTime[PID];
+    }
+
+    double Serial = TimeRelayout(&Windows);
+    EXPECT(AreWritesInQueuedOrder());
+    EXPECT(Serial >= Sum);
+
+    if(!KwmStartDispatchPool())
+    {
+        std::cout << "Could not create dispatch pool!" << std::endl;
+        return 1;
+    }
+
+    double Parallel = TimeRelayout(&Windows);
+    EXPECT(AreWritesInQueuedOrder());
+    EXPECT(Parallel >= Slowest);
+    EXPECT(Parallel < Slowest * 1.25);
+
+    std::cout << "dispatch_test: 20 windows, slowest application " << Slowest << "ms, sum " << Sum << "ms" << std::endl;
+    std::cout << "dispatch_test: inline " << (int)Serial << "ms, dispatch pool " << (int)Parallel << "ms" << std::endl;
+    std::cout << "dispatch_test: " << (Failures ? "FAILED" : "OK") << std::endl;
+    return Failures ? 1 : 0;
+}
@@ -0,0 +1,132 @@
+#include "../kwm/kwm.h"
+
+// Checks GetWindowAtPoint against a scan of WindowLst, which picks the
+// front-most window that contains the point. Links all of Kwm, so it only
+// builds on macOS.
+extern std::vector<window_info> WindowLst;
+int Failures = 0;
+
+#define EXPECT(Condition) \
+    do { if(!(Condition)) { std::cout << __FILE__ << ":" << __LINE__ << ": expected " << #Condition << std::endl; ++Failures; } } while(0)
+
+window_info *GetWindowAtPointByScan(CGPoint Point)
+{
+    for(std::size_t WindowIndex = 0; WindowIndex < WindowLst.size(); ++WindowIndex)
+    {
+        window_info *Window = &WindowLst[WindowIndex];
+        if(Point.x >= Window->X &&
+           Point.x <= Window->X + Window->Width &&
+           Point.y >= Window->Y &&
+           Point.y <= Window->Y + Window->Height)
+        {
+            return Window;
+        }
+    }
+
+    return NULL;
+}
+
+// Windows are spread over two displays side by side, one of them to the
+// left of the origin, and may overlap.
+void CreateRandomWindows(int Count)
+{
+    WindowLst.resize(Count);
+    for(int WindowIndex = 0; WindowIndex < Count; ++WindowIndex)
+    {
+        window_info *Window = &WindowLst[WindowIndex];
+        Window->WID = WindowIndex;
+        Window->X = rand() % 5120 - 2560;
+        Window->Y = rand() % 1440 - 20;
+        Window->Width = 1 + rand() % 1200;
+        Window->Height = 1 + rand() % 900;
+    }
+
+    InvalidateWindowGrid();
+}
+
+CGPoint GetRandomPoint()
+{
+    CGPoint Point = { (double)(rand() % 5600 - 2800), (double)(rand() % 1700 - 100) };
+    return Point;
+}
+
+void ExpectSameWindowAtPoint(CGPoint Point)
+{
+    window_info *Grid = GetWindowAtPoint(Point);
+    window_info *Scan = GetWindowAtPointByScan(Point);
+    EXPECT(Grid == Scan);
+}
+
+// The edges of a window are part of it, so the corners are checked as well
+// as the points just outside of them.
+void ExpectSameWindowAtEdges(window_info *Window)
+{
+    double Xs[] = { Window->X - 0.5, (double)Window->X, Window->X + Window->Width / 2.0, (double)Window->X + Window->Width, Window->X + Window->Width + 0.5 };
+    double Ys[] = { Window->Y - 0.5, (double)Window->Y, Window->Y + Window->Height / 2.0, (double)Window->Y + Window->Height, Window->Y + Window->Height + 0.5 };
+    for(int XIndex = 0; XIndex < 5; ++XIndex)
+    {
+        for(int YIndex = 0; YIndex < 5; ++YIndex)
+        {
+            CGPoint Point = { Xs[XIndex], Ys[YIndex] };
+            ExpectSameWindowAtPoint(Point);
+        }
+    }
+}
+
+void TestEmptyWindowList()
+{
+    WindowLst.clear();
+    InvalidateWindowGrid();
+
+    CGPoint Point = { 10, 10 };
+    EXPECT(GetWindowAtPoint(Point) == NULL);
+}
+
+void TestRandomWindows()
+{
+    int WindowCounts[] = { 1, 2, 10, 50, 200 };
+    for(int CountIndex = 0; CountIndex < 5; ++CountIndex)
+    {
+        for(int Round = 0; Round < 20; ++Round)
+        {
+            CreateRandomWindows(WindowCounts[CountIndex]);
+            for(int PointIndex = 0; PointIndex < 500; ++PointIndex)
+                ExpectSameWindowAtPoint(GetRandomPoint());
+
+            for(std::size_t WindowIndex = 0; WindowIndex < WindowLst.size(); ++WindowIndex)
+                ExpectSameWindowAtEdges(&WindowLst[WindowIndex]);
+        }
+    }
+}
+
+// A window that moves after the grid was built must be found at its new
+// frame once the grid is invalidated, as ApplyWindowFrame does.
+void TestMovedWindow()
+{
+    CreateRandomWindows(50);
+    CGPoint Point = GetRandomPoint();
+    GetWindowAtPoint(Point);
+
+    window_info *Window = &WindowLst[0];
+    Window->X = 3000;
+    Window->Y = 2000;
+    Window->Width = 100;
+    Window->Height = 100;
+    InvalidateWindowGrid();
+
+    CGPoint Inside = { 3050, 2050 };
+    EXPECT(GetWindowAtPoint(Inside) == Window);
+    ExpectSameWindowAtEdges(Window);
+}
+
+int main()
+{
+    srand(1);
+
+    TestEmptyWindowList();
+    TestRandomWindows();
+    TestMovedWindow();
+
+    std::cout << "grid_test: " << (Failures ? "FAILED" : "OK") << std::endl;
+    return Failures ? 1 : 0;
+}
@@ -0,0 +1,252 @@
+#include "../kwm/monitor.h"
+
+#include <iostream>
+#include <unistd.h>
+
+// The fake callbacks only count how often the monitor calls them. Every
+// round is run with an explicit time, so the timeouts do not have to be
+// waited out, except by the round trip through the queue at the end.
+kwm_monitor KWMMonitor;
+
+int Commands = 0;
+int HandledEvents = 0;
+int Probes = 0;
+bool FakeTransition = false;
+bool FakeSpaceChanged = false;
+int CommandWritePID = -1;
+int Failures = 0;
+
+#define EXPECT(Condition) \
+    do { if(!(Condition)) { std::cout << __FILE__ << ":" << __LINE__ << ": expected " << #Condition << std::endl; ++Failures; } } while(0)
+
+KWM_MONITOR_STEP(FakeRunCommands)
+{
+    ++Commands;
+    if(CommandWritePID != -1)
+        RecordFrameWrite(CommandWritePID);
+
+    return true;
+}
+
+KWM_MONITOR_HANDLE_EVENTS(FakeHandleEvents)
+{
+    HandledEvents += Events->size();
+}
+
+KWM_MONITOR_STEP(FakeUpdateWindows)
+{
+    return FakeTransition;
+}
+
+KWM_MONITOR_STEP(FakeHasSpaceChanged)
+{
+    ++Probes;
+    return FakeSpaceChanged;
+}
+
+kwm_time_point After(kwm_time_point Time, int Milliseconds)
+{
+    return Time + std::chrono::milliseconds(Milliseconds);
+}
+
+void ResetMonitor(kwm_time_point Now)
+{
+    KWMMonitor.Queue.clear();
+    KWMMonitor.FrameWrites.clear();
+    KWMMonitor.Woken = false;
+    KWMMonitor.Transition = false;
+    KWMMonitor.MovePending = false;
+    KWMMonitor.LastUpdate = Now;
+    KWMMonitor.LastProbe = Now;
+    KWMMonitor.Updates = 0;
+    KWMMonitor.CoalescedMoves = 0;
+    KWMMonitor.EchoedMoves = 0;
+
+    Commands = HandledEvents = Probes = 0;
+    FakeTransition = FakeSpaceChanged = false;
+    CommandWritePID = -1;
+}
+
+int RunRound(kwm_time_point Now, window_event_type Type, int PID)
+{
+    std::vector<window_event> Events;
+    window_event Event = { Type, PID, -1 };
+    Events.push_back(Event);
+    return RunWindowMonitor(&Events, Now);
+}
+
+int RunEmptyRound(kwm_time_point Now)
+{
+    std::vector<window_event> Events;
+    return RunWindowMonitor(&Events, Now);
+}
+
+void TestStructuralEvents(kwm_time_point Start)
+{
+    ResetMonitor(Start);
+    int Timeout = RunRound(After(Start, 10), WindowEventCreated, 1);
+    EXPECT(KWMMonitor.Updates == 1);
+    EXPECT(Commands == 1);
+    EXPECT(HandledEvents == 1);
+    EXPECT(Timeout > 0 && Timeout <= KWMMonitor.SpaceTimeout + 1);
+
+    RunRound(After(Start, 20), WindowEventDestroyed, 1);
+    RunRound(After(Start, 30), DisplayEventChanged, 0);
+    EXPECT(KWMMonitor.Updates == 3);
+}
+
+void TestMovesAreCoalesced(kwm_time_point Start)
+{
+    ResetMonitor(Start);
+    int Timeout = RunRound(Start, WindowEventMoved, 1);
+    EXPECT(KWMMonitor.Updates == 0);
+    EXPECT(KWMMonitor.MovePending);
+    EXPECT(Timeout > 0 && Timeout <= KWMMonitor.MoveDelay + 1);
+
+    for(int Move = 1; Move < 10; ++Move)
+        RunRound(After(Start, Move * 16), WindowEventMoved, 1);
+
+    EXPECT(KWMMonitor.Updates == 0);
+    EXPECT(KWMMonitor.CoalescedMoves == 9);
+
+    RunEmptyRound(After(Start, KWMMonitor.MoveDelay));
+    EXPECT(KWMMonitor.Updates == 1);
+    EXPECT(!KWMMonitor.MovePending);
+}
+
+void TestEchoesAreDropped()
+{
+    ResetMonitor(std::chrono::steady_clock::now());
+    RecordFrameWrite(7);
+    kwm_time_point Start = std::chrono::steady_clock::now();
+
+    RunRound(Start, WindowEventMoved, 7);
+    EXPECT(KWMMonitor.EchoedMoves == 1);
+    EXPECT(!KWMMonitor.MovePending);
+
+    RunRound(Start, WindowEventMoved, 8);
+    EXPECT(KWMMonitor.MovePending);
+
+    ResetMonitor(Start);
+    RecordFrameWrite(7);
+    RunRound(After(std::chrono::steady_clock::now(), KWMMonitor.EchoTimeout + 1), WindowEventMoved, 7);
+    EXPECT(KWMMonitor.EchoedMoves == 0);
+    EXPECT(KWMMonitor.MovePending);
+    EXPECT(KWMMonitor.FrameWrites.empty());
+}
+
+// The frames written by the commands of a round must not turn the moves
+// that were already queued in that round into echoes.
+void TestCommandWritesDoNotDropQueuedMoves(kwm_time_point Start)
+{
+    ResetMonitor(Start);
+    CommandWritePID = 3;
+    RunRound(Start, WindowEventMoved, 3);
+    EXPECT(KWMMonitor.EchoedMoves == 0);
+    EXPECT(KWMMonitor.MovePending);
+}
+
+void TestCommandsOnly(kwm_time_point Start)
+{
+    ResetMonitor(Start);
+    RunEmptyRound(After(Start, 50));
+    EXPECT(Commands == 1);
+    EXPECT(KWMMonitor.Updates == 0);
+    EXPECT(Probes == 0);
+}
+
+void TestPollFallback(kwm_time_point Start)
+{
+    ResetMonitor(Start);
+    RunEmptyRound(After(Start, KWMMonitor.PollTimeout - 1));
+    EXPECT(KWMMonitor.Updates == 0);
+
+    FakeTransition = true;
+    RunEmptyRound(After(Start, KWMMonitor.PollTimeout));
+    EXPECT(KWMMonitor.Updates == 1);
+    EXPECT(KWMMonitor.Transition);
+
+    FakeTransition = false;
+    int Timeout = RunEmptyRound(After(Start, KWMMonitor.PollTimeout + KWMMonitor.TransitionTimeout));
+    EXPECT(KWMMonitor.Updates == 2);
+    EXPECT(!KWMMonitor.Transition);
+    EXPECT(Timeout > 0 && Timeout <= KWMMonitor.SpaceTimeout + 1);
+}
+
+void TestSpaceProbe(kwm_time_point Start)
+{
+    ResetMonitor(Start);
+    RunEmptyRound(After(Start, KWMMonitor.SpaceTimeout - 1));
+    EXPECT(Probes == 0);
+
+    RunEmptyRound(After(Start, KWMMonitor.SpaceTimeout));
+    EXPECT(Probes == 1);
+    EXPECT(KWMMonitor.Updates == 0);
+
+    FakeSpaceChanged = true;
+    RunEmptyRound(After(Start, KWMMonitor.SpaceTimeout * 2));
+    EXPECT(Probes == 2);
+    EXPECT(KWMMonitor.Updates == 1);
+}
+
+void * PushFakeEvents(void*)
+{
+    usleep(20 * 1000);
+    PushWindowEvent(WindowEventCreated, 1, -1);
+    PushWindowEvent(WindowEventMoved, 1, -1);
+    return NULL;
+}
+
+void TestEventQueue()
+{
+    ResetMonitor(std::chrono::steady_clock::now());
+    std::vector<window_event> Events;
+
+    pthread_t Source;
+    pthread_create(&Source, NULL, &PushFakeEvents, NULL);
+    usleep(40 * 1000);
+    EXPECT(WaitForWindowEvents(&Events, 1000));
+    EXPECT(Events.size() == 2);
+    pthread_join(Source, NULL);
+
+    WakeWindowMonitor();
+    kwm_time_point Start = std::chrono::steady_clock::now();
+    EXPECT(!WaitForWindowEvents(&Events, 1000));
+    EXPECT(std::chrono::steady_clock::now() - Start < std::chrono::milliseconds(500));
+
+    Start = std::chrono::steady_clock::now();
+    EXPECT(!WaitForWindowEvents(&Events, 20));
+    EXPECT(std::chrono::steady_clock::now() - Start >= std::chrono::milliseconds(20));
+}
+
+int main()
+{
+    KWMMonitor.RunCommands = FakeRunCommands;
+    KWMMonitor.HandleEvents = FakeHandleEvents;
+    KWMMonitor.UpdateWindows = FakeUpdateWindows;
+    KWMMonitor.HasSpaceChanged = FakeHasSpaceChanged;
+    KWMMonitor.PollTimeout = 1000;
+    KWMMonitor.TransitionTimeout = 200;
+    KWMMonitor.SpaceTimeout = 200;
+    KWMMonitor.MoveDelay = 200;
+    KWMMonitor.EchoTimeout = 250;
+
+    if(!KwmStartWindowMonitor())
+    {
+        std::cout << "Could not create window event queue!" << std::endl;
+        return 1;
+    }
+
+    kwm_time_point Start = std::chrono::steady_clock::now();
+    TestStructuralEvents(Start);
+    TestMovesAreCoalesced(Start);
+    TestEchoesAreDropped();
+    TestCommandWritesDoNotDropQueuedMoves(Start);
+    TestCommandsOnly(Start);
+    TestPollFallback(Start);
+    TestSpaceProbe(Start);
+    TestEventQueue();
+
+    std::cout << "monitor_test: " << (Failures ? "FAILED" : "OK") << std::endl;
+    return Failures ? 1 : 0;
+}